@@ -39,49 +39,84 @@
 #define DS_SIZE_DEFAULT 1024
 /* default call-depth (size of CS): 256 */
 #define CS_SIZE_DEFAULT 256
+/* 16MB linear memory limit by default */
+#define LM_SIZE_DEFAULT (16 * 1024 * 1024)
 
 void usage(const char *progname, int ec, FILE *s)
 {
 	fprintf(s, 
-		"Usage: %s [-h] [-d SIZE] [-c SIZE] file1 [file2 .. fileN]\n",
-		progname);
+		"Usage: %s [-h] [-e ENGINE] [-p] [-s FILE [-F HZ]] [-d SIZE] "
+		"[-c SIZE]\n\t[-m SIZE] [-l MODULE] [-C DIR] [-S FILE] "
+		"file1 [file2 .. fileN]\n"
+		"       %s [-h] [-e ENGINE] [-p] [-s FILE [-F HZ]] [-l MODULE] "
+		"-R FILE\n", progname, progname);
 	fprintf(s, "\n\t-h\tShow this text.");
+	fprintf(s, "\n\t-e ENGINE\tExecute with ENGINE (default %s).",
+			engines[0].name);
+	fprintf(s, "\n\t-p\tProfile instructions, report on exit or SIGUSR1.");
+	fprintf(s, "\n\t-s FILE\tWrite sampled call stacks to FILE (folded).");
+	fprintf(s, "\n\t-F HZ\tSample HZ times per second of CPU time.");
 	fprintf(s, "\n\t-d SIZE\tSet data stack size to SIZE.");
-	fprintf(s, "\n\t-c SIZE\tSet code stack size to SIZE.\n");
+	fprintf(s, "\n\t-c SIZE\tSet code stack size to SIZE.");
+	fprintf(s, "\n\t-m SIZE\tSet linear memory limit to SIZE.");
+	fprintf(s, "\n\t-l MODULE\tLoad native functions from MODULE.");
+	fprintf(s, "\n\t-C DIR\tCache decoded objects in DIR.");
+	fprintf(s, "\n\t-S FILE\tSave snapshot to FILE at SNAPSHOT instruction.");
+	fprintf(s, "\n\t-R FILE\tRestore VM from snapshot FILE and continue.\n");
 	exit(ec);
 }
 
 void auvm_exit(vm_t *vm_status, int ec)
 {
-	int i;
 	if (vm_status->flags & FLAGS_DBG)
 		ds_show(&vm_status->ds);
-	ds_destroy(&vm_status->ds);
-	cs_destroy(&vm_status->cs);
-	in_table_destroy(vm_status->in_table);
-	for (i = 0; i < vm_status->obj_count; i++)
-		obj_unload(&(vm_status->ctbl[i]));
-	free(vm_status->ctbl);
-	free(vm_status);
+	if (vm_status->prof != NULL) {
+		prof_report(vm_status->prof, stderr);
+		prof_destroy(vm_status->prof);
+	}
+	prof_sample_stop(vm_status);
+	auvm_destroy(vm_status);
+	func_module_unload();
 
 	exit(ec);
 }
 
 int main(int argc, char **argv)
 {
-	int opt, filecount;
+	int opt, filecount, ret, profile = 0;
+	unsigned int sample_hz = PROF_SAMPLE_HZ;
+	char *sample_path = NULL, *snap_save = NULL, *snap_load = NULL;
 	char **filearr;
-	uint32_t cs_size, ds_size;
+	const engine_t *engine = &engines[0];
+	uint32_t cs_size, ds_size, lm_size;
 	vm_t *vmst;
 
 	cs_size = CS_SIZE_DEFAULT;
 	ds_size = DS_SIZE_DEFAULT;
+	lm_size = LM_SIZE_DEFAULT;
 
-	while ((opt = getopt(argc, argv, "hd:c:")) != -1) {
+	while ((opt = getopt(argc, argv, "he:ps:F:d:c:m:l:C:S:R:")) != -1) {
 		switch (opt) {
 			case 'h' :
 				usage(argv[0], 0, stdout);
 				break;
+			case 'e' :
+				engine = engine_find(optarg);
+				if (engine == NULL) {
+					fprintf(stderr, "E: Unknown engine "
+							"\'%s\'\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'p' :
+				profile = 1;
+				break;
+			case 's' :
+				sample_path = optarg;
+				break;
+			case 'F' :
+				sscanf(optarg, "%u", &sample_hz);
+				break;
 			case 'd' :
 				sscanf(optarg, "%u", &ds_size);
 #ifdef DEBUG
@@ -96,23 +131,62 @@ int main(int argc, char **argv)
 						cs_size);
 #endif
 				break;
+			case 'm' :
+				sscanf(optarg, "%u", &lm_size);
+#ifdef DEBUG
+				fprintf(stderr, "[DEBUG] lm_size = %u\n",
+						lm_size);
+#endif
+				break;
+			case 'l' :
+				if (func_module_load(optarg) < 0)
+					exit(3);
+				break;
+			case 'C' :
+				obj_cache_dir = optarg;
+				break;
+			case 'S' :
+				snap_save = optarg;
+				break;
+			case 'R' :
+				snap_load = optarg;
+				break;
 			default :
 				usage(argv[0], 1, stderr);
 		}
 	}
 
-	if (optind >= argc)
+	if ((snap_load != NULL) ? (optind < argc) : (optind >= argc))
 		usage(argv[0], 2, stderr);
 
-	filecount = argc - optind;
-	filearr = &argv[optind];
-
-	vmst = auvm_init(ds_size, cs_size, filecount, filearr);
+	if (snap_load != NULL) {
+		vmst = snap_restore(snap_load);
+	} else {
+		filecount = argc - optind;
+		filearr = &argv[optind];
+		vmst = auvm_init(ds_size, cs_size, lm_size, filecount,
+				filearr);
+	}
 	if (vmst == NULL)
 		exit(3);
+	vmst->snap_path = snap_save;
+
+	if (profile) {
+		vmst->prof = prof_init();
+		if (vmst->prof == NULL) {
+			fprintf(stderr, "E: Can't allocate profiling counters\n");
+			auvm_exit(vmst, 3);
+		}
+	}
+
+	if ((sample_path != NULL)
+		&& (prof_sample_start(sample_path, sample_hz) != 0)) {
+		fprintf(stderr, "E: Can't start sampling profiler\n");
+		auvm_exit(vmst, 3);
+	}
 
-	while (!parse(vmst));
+	ret = engine->run(vmst);
 
-	auvm_exit(vmst, 4);
+	auvm_exit(vmst, (ret < 0) ? 4 : ret);
 	return 5; /* This shouldn't happen, so there must be an error */
 }
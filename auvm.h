@@ -50,6 +50,24 @@
 /* From object.h */
 #include "object.h"
 
+/* From mem.h */
+#include "mem.h"
+
+/* From module.h */
+#include "module.h"
+
+/* From prof.h */
+#include "prof.h"
+
+/* From engine.h */
+#include "engine.h"
+
+/* From snap.h */
+#include "snap.h"
+
+/* From vmpool.h */
+#include "vmpool.h"
+
 /* VM status structure */
 typedef struct _vm {
 	/* instruction pointers */
@@ -58,15 +76,30 @@ typedef struct _vm {
 	/* stack pointers */
 	ds_t ds;
 	cs_t cs;
+	/* frame pointer (DS position of current frame's first local) */
+	uint32_t fp;
+	/* loop counters of current frame */
+	uint32_t lc[LOOP_REGS];
+	/* register files, REG_COUNT registers for every call depth */
+	uint64_t *rf;
+	/* linear memory */
+	lm_t lm;
+	arena_t arena;
 	/* instruction table */
 	int (**in_table)(struct _vm *, uint8_t, uint8_t);
 	/* function table */
-	int (**func_table)(struct _vm *);
+	func_wrap_t *func_table;
 	/* object table */
 	uint8_t obj_count;
 	obj_t *ctbl;
 	/* FLAGS register */
 	uint8_t flags;
+	/* argument of END, valid once FLAGS_HALT is set */
+	uint8_t exit_code;
+	/* profiling counters, NULL unless profiling */
+	prof_t *prof;
+	/* where SNAPSHOT saves VM, NULL if it shouldn't */
+	const char *snap_path;
 } vm_t;
 
 #include "ins.h"
@@ -78,6 +111,8 @@ typedef struct _vm {
 #define FLAGS_COMP_LT (1 << 0)
 #define FLAGS_COMP_GT (1 << 1)
 #define FLAGS_DBG (1 << 2)
+#define FLAGS_HALT (1 << 3)
+#define FLAGS_OVF (1 << 4)
 
 /* Flags - format */
 #define AUVMF_FLOAT 0x01
@@ -85,16 +120,55 @@ typedef struct _vm {
 #define AUVMF_UINT 0x03
 #define AUVMF_SINT 0x04
 
+/* Widest integer type, INT_SZ_MAX bytes */
+#ifdef __SIZEOF_INT128__
+typedef unsigned __int128 uint_wide_t;
+typedef __int128 int_wide_t;
+#define INT_SZ_MAX 16
+#else
+typedef uint64_t uint_wide_t;
+typedef int64_t int_wide_t;
+#define INT_SZ_MAX 8
+#endif
+
+/* Flags - compare: format, log2 of size of integers in bits 4-6 */
+#define CMP_FMT(x) ((x) & 0x0f)
+#define CMP_SIZE(x) (1U << (((x) >> 4) & 0x07))
+
+/* Flags - conversion: destination CMP_FLAGS, saturate if CVT_SAT is set */
+#define CVT_SAT 0x80
+
+/* Flags - vectors */
+#define VEC_U8 0x01
+#define VEC_U16 0x02
+#define VEC_U32 0x03
+#define VEC_F32 0x04
+#define VEC_F64 0x05
+#define VEC_128 0x00
+#define VEC_256 0x10
+
+/* Flags - reductions, element type is VEC_F32 or VEC_F64 */
+#define RED_MEM 0x10
+#define RED_ORD 0x20
+
+/* Flags - bulk */
+#define BULK_TOP 0x01
+
 /* Flags - jumps */
 #define JMP_REL 0x00
 #define JMP_ABS 0x01
+#define CALL_FRAME 0x02
 
 /* Instruction functions */
 extern int in_nop(vm_t *, uint8_t, uint8_t);
 extern int in_end(vm_t *, uint8_t, uint8_t);
 extern int in_debug(vm_t *, uint8_t, uint8_t);
 extern int in_stdcall(vm_t *, uint8_t, uint8_t);
+extern int in_snapshot(vm_t *, uint8_t, uint8_t);
 extern int in_stack(vm_t *, uint8_t, uint8_t);
+extern int in_frame(vm_t *, uint8_t, uint8_t);
+extern int in_bulk(vm_t *, uint8_t, uint8_t);
+extern int in_mem(vm_t *, uint8_t, uint8_t);
 extern int in_add(vm_t *, uint8_t, uint8_t);
 extern int in_sub(vm_t *, uint8_t, uint8_t);
 extern int in_mul(vm_t *, uint8_t, uint8_t);
@@ -106,19 +180,39 @@ extern int in_xor(vm_t *, uint8_t, uint8_t);
 extern int in_not(vm_t *, uint8_t, uint8_t);
 extern int in_shl(vm_t *, uint8_t, uint8_t);
 extern int in_shr(vm_t *, uint8_t, uint8_t);
+extern int in_wide(vm_t *, uint8_t, uint8_t);
+extern int in_cvt(vm_t *, uint8_t, uint8_t);
 extern int in_jmp(vm_t *, uint8_t, uint8_t);
 extern int in_ret(vm_t *, uint8_t, uint8_t);
+extern int in_switch(vm_t *, uint8_t, uint8_t);
+extern int in_loop(vm_t *, uint8_t, uint8_t);
 extern int in_cmp(vm_t *, uint8_t, uint8_t);
 extern int in_if(vm_t *, uint8_t, uint8_t);
+extern int in_br(vm_t *, uint8_t, uint8_t);
+extern int in_vec(vm_t *, uint8_t, uint8_t);
+extern int in_red(vm_t *, uint8_t, uint8_t);
+extern int in_imm(vm_t *, uint8_t, uint8_t);
+extern int in_reg(vm_t *, uint8_t, uint8_t);
 
 /* init.c */
-extern vm_t *auvm_init(uint32_t, uint32_t, int, char **);
+extern vm_t *auvm_init(uint32_t, uint32_t, uint32_t, int, char **);
+extern vm_t *auvm_init_shared(const vm_t *);
+extern vm_t *auvm_clone(vm_t *);
+extern void auvm_reset(vm_t *);
+extern void auvm_destroy(vm_t *);
+extern void auvm_destroy_shared(vm_t *);
 
 /* parse.c */
 extern int parse(vm_t *);
+extern int auvm_run(vm_t *);
+
+/* vec.c */
+extern void vec_init(void);
 
 /* util.c */
 extern void *revmemcpy(void *, const void *, uint32_t);
+extern void revmem(void *, uint32_t);
+extern uint64_t hash64(const void *, size_t);
 
 /* auvm.c */
 extern void auvm_exit(vm_t *, int);
@@ -126,10 +220,18 @@ extern void auvm_exit(vm_t *, int);
 /* Externs - AUVM Library functions */
 
 /* io.c */
-extern int wrapper_print_str(vm_t *vm_status);
-extern int wrapper_print_int(vm_t *vm_status);
-extern int wrapper_print_uint(vm_t *vm_status);
-extern int wrapper_print_float(vm_t *vm_status);
-extern int wrapper_print_double(vm_t *vm_status);
+extern int wrapper_print_str(vm_t *vm_status, const func_arg_t *args);
+extern int wrapper_print_int(vm_t *vm_status, const func_arg_t *args);
+extern int wrapper_print_uint(vm_t *vm_status, const func_arg_t *args);
+extern int wrapper_print_float(vm_t *vm_status, const func_arg_t *args);
+extern int wrapper_print_double(vm_t *vm_status, const func_arg_t *args);
+
+/* mem.c */
+extern int wrapper_arena_alloc(vm_t *vm_status, const func_arg_t *args);
+extern int wrapper_arena_mark(vm_t *vm_status, const func_arg_t *args);
+extern int wrapper_arena_release(vm_t *vm_status, const func_arg_t *args);
+extern int wrapper_arena_reset(vm_t *vm_status, const func_arg_t *args);
+extern int wrapper_pool_alloc(vm_t *vm_status, const func_arg_t *args);
+extern int wrapper_pool_free(vm_t *vm_status, const func_arg_t *args);
 
 #endif /* _AUVM_H_ */
@@ -30,32 +30,95 @@
 /* Local includes */
 #include "auvm.h"
 #include "auvmlib.h"
+#include "module.h"
+#include "lib/funcs.h"
 
 /* System includes */
 #include <stdlib.h>
+#include <string.h>
+
+/* AUVM Library functions indexed by stdcall ID */
+static const func_desc_t lib_funcs[FUNC_MODULE_BASE] = {
+#define FUNC(id, name, wrapper, arity, sig) \
+	[id] = { name, &wrapper, arity, sig },
+	AUVMLIB_FUNCS
+#undef FUNC
+};
 
 func_wrap_t *func_table_init(void)
 {
 	func_wrap_t *ret;
+	const func_desc_t *desc;
 	int i;
 
-	ret = (func_wrap_t *)malloc(sizeof(func_wrap_t) * 256);
+	ret = (func_wrap_t *)malloc(sizeof(func_wrap_t) * FUNC_MAX);
 	if (ret == NULL)
 		return NULL;
 
-	/* Initialize to 'undefined' values */
-	for (i = 0; i < 256; i++)
-		ret[i] = NULL;
+	/* Register AUVM Library (no-op when already registered) */
+	for (i = 1; i < FUNC_MODULE_BASE; i++)
+		if (lib_funcs[i].name != NULL)
+			func_register(i, &lib_funcs[i]);
 
-	ret[1] = &wrapper_print_str;
-	ret[2] = &wrapper_print_int;
-	ret[3] = &wrapper_print_uint;
-	ret[4] = &wrapper_print_float;
-	ret[5] = &wrapper_print_double;
+	/* Take functions from registry, including loaded modules */
+	for (i = 0; i < FUNC_MAX; i++) {
+		desc = func_desc(i);
+		ret[i] = (desc != NULL) ? desc->func : NULL;
+	}
 
 	return ret;
 }
 
+/* Pop arguments of function [id] by its signature into args
+ *
+ * When [regs] is given, argument N of fixed width is taken from register
+ * [regs][N] instead, bytes are popped anyway. Stack is left untouched when
+ * there are not enough data on it.
+ */
+int func_args(vm_t *vm_status, uint8_t id, uint64_t *regs,
+		func_arg_t *args)
+{
+	const func_sig_t *sig;
+	uint32_t count = vm_status->ds.st_count;
+	uint64_t len = 0;
+	int i;
+
+	sig = func_sig(id);
+	if (sig == NULL)
+		return 0;
+
+	for (i = 0; i < sig->argc; i++) {
+		if (sig->width[i] == 0) {
+			/* bytes, length is previous argument */
+			len = 0;
+			memcpy(&len, args[i - 1].ptr, args[i - 1].len);
+			if (len > vm_status->ds.st_count)
+				goto fail;
+			args[i].len = (uint32_t)len;
+		} else {
+			args[i].len = sig->width[i];
+			if (regs != NULL) {
+				args[i].ptr = &regs[i];
+				continue;
+			}
+		}
+
+		args[i].ptr = ds_pop(&vm_status->ds, args[i].len);
+		if (args[i].ptr == NULL)
+			goto fail;
+	}
+
+	/* LOAD stored bytes reversed, put them back to original order */
+	for (i = 0; i < sig->argc; i++)
+		if (sig->width[i] == 0)
+			revmem(args[i].ptr, args[i].len);
+	return 0;
+
+fail:
+	vm_status->ds.st_count = count;
+	return 1;
+}
+
 void func_table_destroy(func_wrap_t *func_tbl)
 {
 	free(func_tbl);
@@ -35,12 +35,12 @@
 #include <stddef.h>
 
 #include "auvm.h"
-
-/* Function wrapper prototype */
-typedef int (*func_wrap_t)(vm_t *);
+#include "module.h"
 
 /* Externs - auvmlib.c */
 extern func_wrap_t *func_table_init(void);
 extern void func_table_destroy(func_wrap_t *func_tbl);
+extern int func_args(vm_t *vm_status, uint8_t id, uint64_t *regs,
+		func_arg_t *args);
 
 #endif /* _AUVMLIB_H_ */
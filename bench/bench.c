@@ -0,0 +1,236 @@
+/*
+ * bench/bench.c - Benchmark driver for AUVM
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+/* Local includes */
+#include "../auvm.h"
+
+/* System includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define DS_SIZE_DEFAULT 1024
+#define CS_SIZE_DEFAULT 256
+#define LM_SIZE_DEFAULT (16 * 1024 * 1024)
+
+#define WARMUP_DEFAULT 3
+#define ITERS_DEFAULT 10
+
+void usage(const char *progname, int ec, FILE *s)
+{
+	fprintf(s,
+		"Usage: %s [-h] [-P] [-w COUNT] [-n COUNT] "
+		"file1 [file2 .. fileN]\n", progname);
+	fprintf(s, "\n\t-h\tShow this text.");
+	fprintf(s, "\n\t-P\tLease VMs from pool instead of creating them.");
+	fprintf(s, "\n\t-w COUNT\tUntimed warmup runs (default %d).",
+			WARMUP_DEFAULT);
+	fprintf(s, "\n\t-n COUNT\tTimed runs (default %d).\n", ITERS_DEFAULT);
+	exit(ec);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Run object once, set number of executed instructions and time taken by
+ * execution and by VM setup and teardown (from [pool] if it isn't NULL)
+ */
+static int run(char *fname, vmpool_t *pool, uint64_t *count, uint64_t *ns,
+		uint64_t *setup_ns)
+{
+	vm_t *vm;
+	uint64_t n = 0, t0;
+	int ret = 0;
+
+	t0 = now_ns();
+	if (pool != NULL)
+		vm = vmpool_lease(pool);
+	else vm = auvm_init(DS_SIZE_DEFAULT, CS_SIZE_DEFAULT, LM_SIZE_DEFAULT,
+			1, &fname);
+	if (vm == NULL)
+		return 1;
+	*setup_ns = now_ns() - t0;
+
+	t0 = now_ns();
+	while (!(vm->flags & FLAGS_HALT)) {
+		if (parse(vm) != 0) {
+			ret = 2;
+			break;
+		}
+		n++;
+	}
+	*ns = now_ns() - t0;
+	*count = n;
+
+	t0 = now_ns();
+	if (pool != NULL)
+		vmpool_release(pool, vm);
+	else auvm_destroy(vm);
+	*setup_ns += now_ns() - t0;
+
+	return ret;
+}
+
+/* Benchmark one object, runs in its own process so peak RSS is its own */
+static int bench(char *fname, int use_pool, int warmup, int iters,
+		FILE *out)
+{
+	uint64_t *ns, *setup_ns, count, prev = 0;
+	vmpool_t *pool = NULL;
+	struct rusage ru;
+	const char *base;
+	int i, j, fd;
+
+	ns = (uint64_t *)malloc(sizeof(uint64_t) * iters);
+	setup_ns = (uint64_t *)malloc(sizeof(uint64_t) * iters);
+	if ((ns == NULL) || (setup_ns == NULL))
+		return 1;
+
+	if (use_pool) {
+		pool = vmpool_create(1, DS_SIZE_DEFAULT, CS_SIZE_DEFAULT,
+				LM_SIZE_DEFAULT, 1, &fname);
+		if (pool == NULL)
+			return 1;
+	}
+
+	/* Keep output of benchmarked programs away from results */
+	fd = open("/dev/null", O_WRONLY);
+	if (fd != -1) {
+		dup2(fd, STDOUT_FILENO);
+		close(fd);
+	}
+
+	for (i = -warmup; i < iters; i++) {
+		j = (i < 0) ? 0 : i;
+		if (run(fname, pool, &count, &ns[j], &setup_ns[j]) != 0) {
+			fprintf(stderr, "E: Benchmark \'%s\' failed\n", fname);
+			return 2;
+		}
+		/* Programs are deterministic, count must not change */
+		if ((i > -warmup) && (count != prev)) {
+			fprintf(stderr, "E: Benchmark \'%s\' isn't repeatable\n",
+					fname);
+			return 3;
+		}
+		prev = count;
+	}
+
+	qsort(ns, iters, sizeof(uint64_t), &cmp_u64);
+	qsort(setup_ns, iters, sizeof(uint64_t), &cmp_u64);
+	getrusage(RUSAGE_SELF, &ru);
+
+	base = strrchr(fname, '/');
+	base = (base != NULL) ? base + 1 : fname;
+	fprintf(out, "%-12s %12llu %12.3f %12.3f %10.2f %8.2f %10.2f %10ld\n",
+			base, (unsigned long long)count, ns[iters / 2] / 1e6,
+			ns[0] / 1e6, (double)ns[iters / 2] / count,
+			count / (ns[iters / 2] / 1e3), setup_ns[iters / 2] / 1e3,
+			ru.ru_maxrss);
+	fflush(out);
+	free(ns);
+	free(setup_ns);
+	if (pool != NULL)
+		vmpool_destroy(pool);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int opt, i, status, ret = 0;
+	int warmup = WARMUP_DEFAULT, iters = ITERS_DEFAULT, use_pool = 0;
+	pid_t pid;
+	FILE *out;
+
+	while ((opt = getopt(argc, argv, "hPw:n:")) != -1) {
+		switch (opt) {
+			case 'h' :
+				usage(argv[0], 0, stdout);
+				break;
+			case 'P' :
+				use_pool = 1;
+				break;
+			case 'w' :
+				sscanf(optarg, "%d", &warmup);
+				break;
+			case 'n' :
+				sscanf(optarg, "%d", &iters);
+				break;
+			default :
+				usage(argv[0], 1, stderr);
+		}
+	}
+
+	if ((optind >= argc) || (warmup < 0) || (iters < 1))
+		usage(argv[0], 2, stderr);
+
+	/* Results go to original stdout */
+	out = fdopen(dup(STDOUT_FILENO), "w");
+	if (out == NULL)
+		return 3;
+
+	fprintf(out, "warmup %d, runs %d, times are medians (min)\n\n",
+			warmup, iters);
+	fprintf(out, "%-12s %12s %12s %12s %10s %8s %10s %10s\n",
+			"benchmark", "instr", "ms", "min ms", "ns/instr",
+			"Minstr/s", "setup us", "rss kB");
+	fflush(out);
+
+	for (i = optind; i < argc; i++) {
+		pid = fork();
+		if (pid == -1)
+			return 4;
+		if (pid == 0)
+			exit(bench(argv[i], use_pool, warmup, iters, out));
+		if ((waitpid(pid, &status, 0) == -1) || !WIFEXITED(status)
+			|| (WEXITSTATUS(status) != 0))
+			ret = 5;
+	}
+
+	fclose(out);
+	return ret;
+}
@@ -0,0 +1,428 @@
+/*
+ * bench/engines.c - Differential test and comparison of AUVM engines
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+/* Local includes */
+#include "../auvm.h"
+
+/* System includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define DS_SIZE_DEFAULT 1024
+#define CS_SIZE_DEFAULT 256
+#define LM_SIZE_DEFAULT (16 * 1024 * 1024)
+
+#define ITERS_DEFAULT 5
+
+/* Outcome of running one object with one engine */
+struct _result {
+	int ret;
+	uint64_t ns;
+	uint32_t ds_count;
+	uint8_t *ds;
+	size_t out_len;
+	uint8_t *out;
+};
+typedef struct _result result_t;
+
+void usage(const char *progname, int ec, FILE *s)
+{
+	fprintf(s, "Usage: %s [-h] [-n COUNT] file1 [file2 .. fileN]\n",
+			progname);
+	fprintf(s, "\n\t-h\tShow this text.");
+	fprintf(s, "\n\t-n COUNT\tTimed runs per engine (default %d).\n",
+			ITERS_DEFAULT);
+	fprintf(s, "\nFirst engine is the reference, others are compared to "
+		"it. If FILE.exp\n(FILE without .bin) exists, reference is "
+		"checked against it too. Its\nlines are \"exit CODE\", "
+		"\"stack HEX\" (final data stack bytes in host order,\n"
+		"bottom first) and \"out COUNT \"STRING\"\" (STRING with C "
+		"escapes printed\nCOUNT times), ';' starts comment. Missing "
+		"ones mean exit 0, empty stack and\nno output.\n");
+	exit(ec);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Read whole temporary file */
+static uint8_t *slurp(FILE *f, size_t *len)
+{
+	uint8_t *ret;
+	long sz;
+
+	fseek(f, 0, SEEK_END);
+	sz = ftell(f);
+	rewind(f);
+	ret = (uint8_t *)malloc((sz > 0) ? sz : 1);
+	if (ret == NULL)
+		return NULL;
+	*len = fread(ret, 1, sz, f);
+	return ret;
+}
+
+/* Child: run object, first run's stdout goes to [out], result to [res] */
+static int child(char *fname, const engine_t *engine, int iters, FILE *out,
+		FILE *res)
+{
+	uint64_t *ns;
+	vm_t *vm;
+	int i, fd, ret = 0;
+
+	ns = (uint64_t *)malloc(sizeof(uint64_t) * iters);
+	if (ns == NULL)
+		return 1;
+
+	fflush(stdout);
+	dup2(fileno(out), STDOUT_FILENO);
+
+	for (i = 0; i < iters; i++) {
+		vm = auvm_init(DS_SIZE_DEFAULT, CS_SIZE_DEFAULT,
+				LM_SIZE_DEFAULT, 1, &fname);
+		if (vm == NULL)
+			return 2;
+
+		ns[i] = now_ns();
+		ret = engine->run(vm);
+		ns[i] = now_ns() - ns[i];
+
+		if (i == 0) {
+			/* Keep only output of first run */
+			fd = open("/dev/null", O_WRONLY);
+			if (fd != -1) {
+				dup2(fd, STDOUT_FILENO);
+				close(fd);
+			}
+			fwrite(&ret, sizeof(int), 1, res);
+			fwrite(&vm->ds.st_count, sizeof(uint32_t), 1, res);
+			fwrite(vm->ds.st_data, 1, vm->ds.st_count, res);
+		}
+		auvm_destroy(vm);
+	}
+
+	qsort(ns, iters, sizeof(uint64_t), &cmp_u64);
+	fwrite(&ns[iters / 2], sizeof(uint64_t), 1, res);
+	fflush(res);
+	free(ns);
+
+	return 0;
+}
+
+static int run(char *fname, const engine_t *engine, int iters, result_t *r)
+{
+	FILE *out, *res;
+	uint8_t *buf;
+	size_t len, need;
+	pid_t pid;
+	int status;
+
+	memset(r, 0, sizeof(result_t));
+	out = tmpfile();
+	res = tmpfile();
+	if ((out == NULL) || (res == NULL))
+		return 1;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid == -1)
+		return 2;
+	if (pid == 0)
+		exit(child(fname, engine, iters, out, res));
+	if ((waitpid(pid, &status, 0) == -1) || !WIFEXITED(status)
+		|| (WEXITSTATUS(status) != 0))
+		return 3;
+
+	r->out = slurp(out, &r->out_len);
+	buf = slurp(res, &len);
+	fclose(out);
+	fclose(res);
+	if ((r->out == NULL) || (buf == NULL))
+		return 4;
+
+	/* ret, ds_count, ds data, ns */
+	need = sizeof(int) + sizeof(uint32_t);
+	if (len < need)
+		return 5;
+	memcpy(&r->ret, buf, sizeof(int));
+	memcpy(&r->ds_count, buf + sizeof(int), sizeof(uint32_t));
+	if (len != need + r->ds_count + sizeof(uint64_t))
+		return 5;
+	r->ds = (uint8_t *)malloc(r->ds_count + 1);
+	if (r->ds == NULL)
+		return 4;
+	memcpy(r->ds, buf + need, r->ds_count);
+	memcpy(&r->ns, buf + need + r->ds_count, sizeof(uint64_t));
+	free(buf);
+
+	return 0;
+}
+
+/* Append [count] times string in quotes at [p] to [e] output, C escapes
+ * are decoded; nonzero on syntax error */
+static int expect_out(result_t *e, unsigned long count, const char *p)
+{
+	uint8_t *buf, *out;
+	size_t len = 0, i;
+	unsigned int x;
+	int n;
+
+	if (*p++ != '"')
+		return 1;
+	buf = (uint8_t *)malloc(strlen(p) + 1);
+	if (buf == NULL)
+		return 1;
+	for (; (*p != '"') && (*p != '\0'); p++) {
+		if (*p != '\\') {
+			buf[len++] = *p;
+			continue;
+		}
+		switch (*++p) {
+			case 'n' : buf[len++] = '\n'; break;
+			case 't' : buf[len++] = '\t'; break;
+			case '\\' : buf[len++] = '\\'; break;
+			case '"' : buf[len++] = '"'; break;
+			case 'x' :
+				if (sscanf(p + 1, "%2x%n", &x, &n) != 1) {
+					free(buf);
+					return 1;
+				}
+				buf[len++] = (uint8_t)x;
+				p += n;
+				break;
+			default :
+				free(buf);
+				return 1;
+		}
+	}
+	if (*p != '"') {
+		free(buf);
+		return 1;
+	}
+
+	out = (uint8_t *)realloc(e->out, e->out_len + count * len + 1);
+	if (out == NULL) {
+		free(buf);
+		return 1;
+	}
+	e->out = out;
+	for (i = 0; i < count; i++, e->out_len += len)
+		memcpy(e->out + e->out_len, buf, len);
+	free(buf);
+	return 0;
+}
+
+/* Read expected outcome of object [fname] from its .exp file
+ *
+ * Returns 1 if there is none, -1 if it can't be parsed.
+ */
+static int expect_load(const char *fname, result_t *e)
+{
+	char *path, *line, *p;
+	size_t len, lineno = 0;
+	unsigned long count;
+	unsigned int x;
+	int n, ret = 0;
+	FILE *f;
+
+	memset(e, 0, sizeof(result_t));
+	len = strlen(fname);
+	if ((len > 4) && (strcmp(fname + len - 4, ".bin") == 0))
+		len -= 4;
+	path = (char *)malloc(len + sizeof(".exp"));
+	if (path == NULL)
+		return -1;
+	memcpy(path, fname, len);
+	strcpy(path + len, ".exp");
+	f = fopen(path, "r");
+	free(path);
+	if (f == NULL)
+		return 1;
+
+	line = NULL;
+	len = 0;
+	while ((ret == 0) && (getline(&line, &len, f) != -1)) {
+		lineno++;
+		p = line + strspn(line, " \t");
+		if ((*p == ';') || (*p == '\n') || (*p == '\0'))
+			continue;
+		if (sscanf(p, "exit %d", &e->ret) == 1)
+			continue;
+		if (strncmp(p, "stack ", 6) == 0) {
+			p += 6;
+			e->ds = (uint8_t *)realloc(e->ds, strlen(p) / 2 + 1);
+			if (e->ds == NULL)
+				ret = -1;
+			e->ds_count = 0;
+			while ((ret == 0)
+				&& (sscanf(p, "%2x%n", &x, &n) == 1)) {
+				e->ds[e->ds_count++] = (uint8_t)x;
+				p += n;
+			}
+			continue;
+		}
+		if ((sscanf(p, "out %lu %n", &count, &n) == 1)
+			&& (expect_out(e, count, p + n) == 0))
+			continue;
+		fprintf(stderr, "E: %s.exp:%lu: can't parse\n", fname,
+				(unsigned long)lineno);
+		ret = -1;
+	}
+	free(line);
+	fclose(f);
+	return ret;
+}
+
+/* Print outcome [r] the way .exp file states it */
+static void expect_show(const result_t *r)
+{
+	uint32_t i;
+
+	printf("\texit %d\n\tstack ", r->ret);
+	for (i = 0; i < r->ds_count; i++)
+		printf("%02x", r->ds[i]);
+	printf("\n");
+}
+
+static void result_free(result_t *r)
+{
+	free(r->ds);
+	free(r->out);
+}
+
+/* Describe difference between result and reference, NULL if none */
+static const char *result_diff(const result_t *r, const result_t *ref)
+{
+	if (r->ret != ref->ret)
+		return "DIFF exit";
+	if ((r->ds_count != ref->ds_count)
+		|| (memcmp(r->ds, ref->ds, r->ds_count) != 0))
+		return "DIFF stack";
+	if ((r->out_len != ref->out_len)
+		|| (memcmp(r->out, ref->out, r->out_len) != 0))
+		return "DIFF stdout";
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	int opt, i, j, iters = ITERS_DEFAULT, ret = 0, has_exp;
+	result_t ref, r, exp;
+	const char *diff, *base, *status;
+
+	while ((opt = getopt(argc, argv, "hn:")) != -1) {
+		switch (opt) {
+			case 'h' :
+				usage(argv[0], 0, stdout);
+				break;
+			case 'n' :
+				sscanf(optarg, "%d", &iters);
+				break;
+			default :
+				usage(argv[0], 1, stderr);
+		}
+	}
+
+	if ((optind >= argc) || (iters < 1))
+		usage(argv[0], 2, stderr);
+
+	printf("%-12s %-8s %-12s %8s %6s %10s %8s\n", "object", "engine",
+			"status", "exit", "stack", "ms", "speedup");
+
+	for (i = optind; i < argc; i++) {
+		base = strrchr(argv[i], '/');
+		base = (base != NULL) ? base + 1 : argv[i];
+
+		/* First engine is the reference */
+		if (run(argv[i], &engines[0], iters, &ref) != 0) {
+			printf("%-12s %-8s %-12s\n", base, engines[0].name,
+					"FAILED");
+			ret = 1;
+			continue;
+		}
+
+		/* Reference has to give expected outcome, if it is known */
+		status = "reference";
+		has_exp = expect_load(argv[i], &exp);
+		if (has_exp < 0) {
+			status = "BAD exp";
+			ret = 1;
+		} else if (has_exp == 0) {
+			diff = result_diff(&ref, &exp);
+			status = (diff != NULL) ? diff : "expected";
+			if (diff != NULL)
+				ret = 1;
+		}
+		printf("%-12s %-8s %-12s %8d %6u %10.3f %8.2f\n", base,
+				engines[0].name, status, ref.ret,
+				ref.ds_count, ref.ns / 1e6, 1.0);
+		if ((has_exp == 0) && (diff != NULL))
+			expect_show(&ref);
+		result_free(&exp);
+
+		for (j = 1; engines[j].name != NULL; j++) {
+			if (run(argv[i], &engines[j], iters, &r) != 0) {
+				printf("%-12s %-8s %-12s\n", base,
+						engines[j].name, "FAILED");
+				ret = 1;
+				result_free(&r);
+				continue;
+			}
+			diff = result_diff(&r, &ref);
+			if (diff != NULL)
+				ret = 1;
+			printf("%-12s %-8s %-12s %8d %6u %10.3f %8.2f\n", base,
+					engines[j].name,
+					(diff != NULL) ? diff : "ok", r.ret,
+					r.ds_count, r.ns / 1e6,
+					(double)ref.ns / r.ns);
+			result_free(&r);
+		}
+		result_free(&ref);
+	}
+
+	return ret;
+}
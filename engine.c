@@ -0,0 +1,91 @@
+/*
+ * engine.c - execution engines
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* Local includes */
+#include "auvm.h"
+#include "engine.h"
+#include "intable.h"
+
+/* System includes */
+#include <string.h>
+
+/* Same as auvm_run, but without per-instruction debug and profiling
+ * hooks in the loop; falls back to parse() while any of them is active.
+ */
+static int run_fast(vm_t *vm_status)
+{
+	const uint8_t *code;
+	uint32_t addr;
+	uint8_t in_num, in_arg;
+
+	while (!(vm_status->flags & FLAGS_HALT)) {
+		if ((vm_status->flags & FLAGS_DBG) || (vm_status->prof != NULL)
+			|| prof_sample_pending) {
+			if (parse(vm_status) != 0)
+				return -1;
+			continue;
+		}
+
+		addr = vm_status->nip.addr;
+		code = &vm_status->ctbl[vm_status->nip.obj].data[addr];
+		in_num = code[0];
+		in_arg = code[1];
+		vm_status->cip = vm_status->nip;
+
+		if (in_num == IN_LOAD) {
+			vm_status->nip.addr = addr + 2 + in_arg;
+			if (ds_push(&vm_status->ds, in_arg, code + 2) != 0)
+				return -1;
+			continue;
+		}
+
+		vm_status->nip.addr = addr + 2;
+		if ((*vm_status->in_table[in_num])(vm_status, in_num, in_arg)
+			!= 0)
+			return -1;
+	}
+
+	return vm_status->exit_code;
+}
+
+const engine_t engines[] = {
+	{ "parse", &auvm_run },
+	{ "fast", &run_fast },
+	{ NULL, NULL }
+};
+
+const engine_t *engine_find(const char *name)
+{
+	int i;
+
+	for (i = 0; engines[i].name != NULL; i++)
+		if (strcmp(engines[i].name, name) == 0)
+			return &engines[i];
+	return NULL;
+}
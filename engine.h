@@ -0,0 +1,53 @@
+#ifndef _ENGINE_H_
+#define _ENGINE_H_
+
+/*
+ * engine.h - execution engines
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* Execution engine
+ *
+ * Every engine runs VM from nip until END and returns END's argument, or -1
+ * when an instruction fails. All engines must give the same results (data
+ * stack, exit code and output) for the same objects; first engine in table
+ * is the reference.
+ */
+struct _vm;
+
+struct _engine {
+	const char *name;
+	int (*run)(struct _vm *);
+};
+typedef struct _engine engine_t;
+
+/* NULL-terminated table of engines */
+extern const engine_t engines[];
+
+extern const engine_t *engine_find(const char *);
+
+#endif /* _ENGINE_H_ */
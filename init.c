@@ -31,14 +31,17 @@
 #include "auvm.h"
 #include "stack.h"
 #include "object.h"
+#include "mem.h"
 #include "ins.h"
 
 /* System includes */
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-vm_t *auvm_init(uint32_t ds_sz, uint32_t cs_sz,	int argc, char **argv)
+/* Allocate VM with empty stacks and memory, tables and objects not set */
+static vm_t *vm_alloc(uint32_t ds_sz, uint32_t cs_sz, uint32_t lm_sz)
 {
-	int i;
 	vm_t *ret;
 
 	/* Allocate VM status struct */
@@ -46,12 +49,6 @@ vm_t *auvm_init(uint32_t ds_sz, uint32_t cs_sz,	int argc, char **argv)
 	if (ret == NULL)
 		return NULL;
 
-	/* Initialize instruction pointers */
-	ret->cip.addr = 0;
-	ret->cip.obj = 0;
-	ret->nip.addr = 0;
-	ret->nip.obj = 0;
-	
 	/* Initialize stacks */
 	if (ds_init(&(ret->ds), ds_sz) != 0) {
 		free(ret);
@@ -64,22 +61,58 @@ vm_t *auvm_init(uint32_t ds_sz, uint32_t cs_sz,	int argc, char **argv)
 		return NULL;
 	}
 
-	/* Load instruction table */
-	ret->in_table = in_table_init();
-	if (ret->in_table == NULL) {
+	/* Register file for every call depth */
+	ret->rf = (uint64_t *)calloc(REG_COUNT * (size_t)cs_sz,
+			sizeof(uint64_t));
+	if (ret->rf == NULL) {
 		ds_destroy(&ret->ds);
 		cs_destroy(&ret->cs);
 		free(ret);
 		return NULL;
 	}
 
-	/* Load AUVM Library */
-	ret->func_table = func_table_init();
-	if (ret->func_table == NULL) {
+	/* Reserve linear memory */
+	if (lm_init(&(ret->lm), lm_sz) != 0) {
 		ds_destroy(&ret->ds);
 		cs_destroy(&ret->cs);
-		in_table_destroy(ret->in_table);
+		free(ret->rf);
 		free(ret);
+		return NULL;
+	}
+
+	ret->in_table = NULL;
+	ret->func_table = NULL;
+	ret->obj_count = 0;
+	ret->ctbl = NULL;
+	ret->prof = NULL;
+	ret->snap_path = NULL;
+
+	auvm_reset(ret);
+	return ret;
+}
+
+vm_t *auvm_init(uint32_t ds_sz, uint32_t cs_sz, uint32_t lm_sz, int argc,
+		char **argv)
+{
+	int i;
+	vm_t *ret;
+
+	ret = vm_alloc(ds_sz, cs_sz, lm_sz);
+	if (ret == NULL)
+		return NULL;
+
+	/* Load instruction table */
+	ret->in_table = in_table_init();
+	if (ret->in_table == NULL) {
+		auvm_destroy(ret);
+		return NULL;
+	}
+
+	/* Load AUVM Library */
+	ret->func_table = func_table_init();
+	if (ret->func_table == NULL) {
+		auvm_destroy(ret);
+		return NULL;
 	}
 
 	/* Load object table:
@@ -87,44 +120,145 @@ vm_t *auvm_init(uint32_t ds_sz, uint32_t cs_sz,	int argc, char **argv)
 	 *  argv is array of strings containing objects
 	 *
 	 *  1. Allocate memory for object table
-	 *  2. Iterate through objects and initialize them
+	 *  2. Register objects by name, each is loaded on first long
+	 *     jump / call into it
+	 *  3. Load first object, execution starts there
 	 */
 
-	ret->obj_count = 0;
 	ret->ctbl = (obj_t *)malloc(sizeof(obj_t) * argc);
 	if (ret->ctbl == NULL) {
-		ds_destroy(&ret->ds);
-		cs_destroy(&ret->cs);
-		in_table_destroy(ret->in_table);
-		func_table_destroy(ret->func_table);
-		free(ret);
+		auvm_destroy(ret);
 		return NULL;
 	}
 
 	for (i = 0; i < argc; i++) {
-		/* 
-		 * This function opens file, reads its contents, parses them
-		 * and set obj_t structure to correct values
-		 */
-		if (obj_load(&(ret->ctbl[i]), argv[i]) != 0) {
-			ds_destroy(&ret->ds);
-			cs_destroy(&ret->cs);
-			in_table_destroy(ret->in_table);
-			func_table_destroy(ret->func_table);
-			for (int j = 0; j < i; j++)
-				obj_unload(&(ret->ctbl[j]));
-			free(ret->ctbl);
-			free(ret);
+		ret->obj_count++;
+		if (obj_register(&(ret->ctbl[i]), argv[i]) != 0) {
+			fprintf(stderr, "E: Can't open object \'%s\'\n",
+					argv[i]);
+			auvm_destroy(ret);
 			return NULL;
 		}
-		ret->obj_count++;
 	}
 
-	ret->flags = 0;
+	if ((argc > 0) && (obj_require(&(ret->ctbl[0])) != 0)) {
+		auvm_destroy(ret);
+		return NULL;
+	}
+
+	return ret;
+}
+
+/* New VM using instruction, function and object tables of [proto]
+ *
+ * Stacks and memory have the same limits as those of [proto], but are
+ * empty. VM has to be freed by auvm_destroy_shared before [proto] is
+ * destroyed.
+ */
+vm_t *auvm_init_shared(const vm_t *proto)
+{
+	vm_t *ret;
+
+	ret = vm_alloc(proto->ds.st_max, proto->cs.st_max, proto->lm.lm_max);
+	if (ret == NULL)
+		return NULL;
+
+	ret->in_table = proto->in_table;
+	ret->func_table = proto->func_table;
+	ret->obj_count = proto->obj_count;
+	ret->ctbl = proto->ctbl;
+
+	return ret;
+}
+
+/* Duplicate running VM [src], sharing its tables like auvm_init_shared
+ *
+ * Linear memory and deep stacks are shared copy-on-write with [src] (see
+ * lm_clone), shallow stacks and register files are copied up to their
+ * current depth only. Profiling and snapshot path are not inherited.
+ * Clone has to be freed by auvm_destroy_shared.
+ */
+vm_t *auvm_clone(vm_t *src)
+{
+	vm_t *ret;
+
+	ret = auvm_init_shared(src);
+	if (ret == NULL)
+		return NULL;
+
+	if (lm_clone(&ret->lm, &src->lm) != 0) {
+		auvm_destroy_shared(ret);
+		return NULL;
+	}
+
+	if ((ds_clone(&ret->ds, &src->ds) != 0)
+		|| (cs_clone(&ret->cs, &src->cs) != 0)) {
+		auvm_destroy_shared(ret);
+		return NULL;
+	}
+	memcpy(ret->rf, src->rf,
+		sizeof(uint64_t) * REG_COUNT * (src->cs.st_count + 1));
+
+	ret->cip = src->cip;
+	ret->nip = src->nip;
+	ret->fp = src->fp;
+	memcpy(ret->lc, src->lc, sizeof(ret->lc));
+	ret->arena = src->arena;
+	ret->flags = src->flags;
+	ret->exit_code = src->exit_code;
+
+	return ret;
+}
+
+/* Put VM into its initial state without freeing anything
+ *
+ * Stacks are emptied by their counters, register file is zeroed, linear
+ * memory is dropped as whole (its contents never survive to next run).
+ */
+void auvm_reset(vm_t *vm_status)
+{
+	vm_status->cip.addr = 0;
+	vm_status->cip.obj = 0;
+	vm_status->nip.addr = 0;
+	vm_status->nip.obj = 0;
+	vm_status->fp = 0;
+	memset(vm_status->lc, 0, sizeof(vm_status->lc));
+	vm_status->ds.st_count = 0;
+	vm_status->cs.st_count = 0;
+	/* Deeper register files are zeroed by CALL */
+	memset(vm_status->rf, 0, sizeof(uint64_t) * REG_COUNT);
+	lm_reset(&vm_status->lm);
+	arena_init(&vm_status->arena);
+	vm_status->exit_code = 0;
+	vm_status->flags = 0;
 #ifdef DEBUG
 	/* Set flags to debug */
-	ret->flags |= FLAGS_DBG;
+	vm_status->flags |= FLAGS_DBG;
 #endif
+}
 
-	return ret;
+/* Free VM created by auvm_init_shared, leaving shared tables alone */
+void auvm_destroy_shared(vm_t *vm_status)
+{
+	vm_status->in_table = NULL;
+	vm_status->func_table = NULL;
+	vm_status->obj_count = 0;
+	vm_status->ctbl = NULL;
+	auvm_destroy(vm_status);
+}
+
+void auvm_destroy(vm_t *vm_status)
+{
+	int i;
+
+	ds_destroy(&vm_status->ds);
+	cs_destroy(&vm_status->cs);
+	free(vm_status->rf);
+	lm_destroy(&vm_status->lm);
+	in_table_destroy(vm_status->in_table);
+	for (i = 0; i < vm_status->obj_count; i++)
+		obj_unload(&(vm_status->ctbl[i]));
+	free(vm_status->ctbl);
+	func_table_destroy(vm_status->func_table);
+	free(vm_status);
 }
@@ -31,9 +31,13 @@
 #include "auvm.h"
 #include "ins.h"
 #include "auvmlib.h"
+#include "mnemonic.h"
 
 /* System includes */
+#include <stdio.h>
 #include <string.h>
+#include <math.h>
+#include <float.h>
 #include <arpa/inet.h>
 
 
@@ -49,10 +53,12 @@ int in_nop(vm_t *vm_status, uint8_t opcode, uint8_t UNUSED(arg))
 
 int in_end(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 {
-	if (opcode == IN_END)
-		auvm_exit(vm_status, arg);
-	/* will never return */
-	return 1;
+	if (opcode != IN_END)
+		return 1;
+	/* auvm_run stops before next instruction */
+	vm_status->exit_code = arg;
+	vm_status->flags |= FLAGS_HALT;
+	return 0;
 }
 
 int in_debug(vm_t *vm_status, uint8_t UNUSED(opcode), uint8_t arg)
@@ -82,6 +88,7 @@ int in_stdcall(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 	 */
 
 	func_wrap_t func;
+	func_arg_t args[FUNC_ARGS_MAX];
 	
 	if (opcode != IN_STDCALL)
 		return 1;
@@ -90,30 +97,54 @@ int in_stdcall(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 	if (func == NULL)
 		return 2;
 
-	return (*func)(vm_status);
+	/* Pop and check arguments declared in function's signature */
+	if (func_args(vm_status, arg, NULL, args) != 0)
+		return 3;
+
+	return (*func)(vm_status, args);
+}
+
+int in_snapshot(vm_t *vm_status, uint8_t UNUSED(opcode), uint8_t arg)
+{
+	if (vm_status->snap_path == NULL)
+		return 0;
+
+	if (snap_save(vm_status, vm_status->snap_path) != 0) {
+		fprintf(stderr, "E: Can't save snapshot to \'%s\'\n",
+				vm_status->snap_path);
+		return 1;
+	}
+	vm_status->exit_code = arg;
+	vm_status->flags |= FLAGS_HALT;
+	return 0;
 }
 
 /* Stack */
 int in_stack(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 {
-	uint8_t buf[arg];
 	uint32_t get_pos;
+	void *src;
 	int ret;
 
 	switch (opcode) {
 		case IN_DUP :
 			/* Duplicate */
-			memcpy(buf, ds_pop(&vm_status->ds, arg), arg);
-			ret = ds_push(&vm_status->ds, arg, buf);
-			ret += ds_push(&vm_status->ds, arg, buf);
+			if (ds_size(&vm_status->ds) < arg)
+				return 1;
+			ret = ds_pushraw(&vm_status->ds, arg,
+				&vm_status->ds.st_data[vm_status->ds.st_count
+					- arg]);
 			break;
 		case IN_GET :
 			/* Get @ position */
-			get_pos = *(uint32_t *)ds_pop(&vm_status->ds,
-					sizeof(uint32_t));
-			memcpy(buf, ds_getelem(&vm_status->ds, arg, get_pos),
-					arg);
-			ret = ds_push(&vm_status->ds, arg, buf);
+			src = ds_pop(&vm_status->ds, sizeof(uint32_t));
+			if (src == NULL)
+				return 1;
+			get_pos = *(uint32_t *)src;
+			src = ds_getelem(&vm_status->ds, arg, get_pos);
+			if (src == NULL)
+				return 1;
+			ret = ds_pushraw(&vm_status->ds, arg, src);
 			break;
 		case IN_DROP :
 			/* Drop head [sz] elements from stack */
@@ -128,16 +159,487 @@ int in_stack(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 	return ret;
 }
 
+/* Immediate forms */
+int in_imm(vm_t *vm_status, uint8_t opcode, uint8_t arg)
+{
+	union {
+		int8_t i8;
+		int16_t i16;
+		int32_t i32;
+		int64_t i64;
+		uint8_t u8;
+		uint16_t u16;
+		uint32_t u32;
+		uint64_t u64;
+	} val;
+	uint64_t imm;
+	uint32_t sz, get_pos;
+	uint8_t *top;
+	void *src;
+
+	switch (opcode) {
+		case IN_ADDI_1 :
+		case IN_ADDI_2 :
+		case IN_ADDI_4 :
+		case IN_ADDI_8 :
+			/* Add to head of the stack in place (modulo, so done
+			 * unsigned) */
+			sz = 1U << (opcode - IN_ADDI_1);
+			if (ds_size(&vm_status->ds) < sz)
+				return 1;
+			top = &vm_status->ds.st_data[vm_status->ds.st_count
+				- sz];
+			memcpy(&val, top, sz);
+			imm = (uint64_t)(int8_t)arg;
+			switch (sz) {
+				case 1 : val.u8 += (uint8_t)imm; break;
+				case 2 : val.u16 += (uint16_t)imm; break;
+				case 4 : val.u32 += (uint32_t)imm; break;
+				case 8 : val.u64 += imm; break;
+			}
+			memcpy(top, &val, sz);
+			return 0;
+		case IN_PUSHI_1 :
+		case IN_PUSHI_2 :
+		case IN_PUSHI_4 :
+		case IN_PUSHI_8 :
+			sz = 1U << (opcode - IN_PUSHI_1);
+			switch (sz) {
+				case 1 : val.i8 = (int8_t)arg; break;
+				case 2 : val.i16 = (int8_t)arg; break;
+				case 4 : val.i32 = (int8_t)arg; break;
+				case 8 : val.i64 = (int8_t)arg; break;
+			}
+			return ds_pushraw(&vm_status->ds, sz, &val);
+		case IN_GETI :
+			memcpy(&get_pos, &vm_status->ctbl[vm_status->cip.obj]
+				.data[vm_status->cip.addr + 2],
+				sizeof(uint32_t));
+			vm_status->nip.addr += sizeof(uint32_t);
+			src = ds_getelem(&vm_status->ds, arg, ntohl(get_pos));
+			if (src == NULL)
+				return 1;
+			return ds_pushraw(&vm_status->ds, arg, src);
+		default :
+			return 1;
+	}
+}
+
+/* Bulk */
+static int bulk_pop(ds_t *ds, uint32_t *val)
+{
+	void *ptr = ds_pop(ds, sizeof(uint32_t));
+	if (ptr == NULL)
+		return 1;
+	memcpy(val, ptr, sizeof(uint32_t));
+	return 0;
+}
+
+/* Check that region [pos, pos + len) lies within the stack */
+static int bulk_check(ds_t *ds, uint32_t pos, uint32_t len)
+{
+	return ((uint64_t)pos + len > ds->st_count);
+}
+
+int in_bulk(vm_t *vm_status, uint8_t opcode, uint8_t arg)
+{
+	ds_t *ds = &vm_status->ds;
+	uint32_t len, src, dst, pos;
+	uint8_t *val;
+	int cmp;
+
+	if (bulk_pop(ds, &len))
+		return 1;
+
+	switch (opcode) {
+		case IN_BCOPY :
+			if (bulk_pop(ds, &src))
+				return 1;
+			if (arg & BULK_TOP) {
+				/* Source can't overlap new top */
+				if (bulk_check(ds, src, len) || ((uint64_t)
+					ds->st_count + len >= ds->st_max))
+					return 1;
+				memcpy(&ds->st_data[ds->st_count],
+						&ds->st_data[src], len);
+				ds->st_count += len;
+				return 0;
+			}
+			if (bulk_pop(ds, &dst) || bulk_check(ds, src, len)
+				|| bulk_check(ds, dst, len))
+				return 1;
+			memmove(&ds->st_data[dst], &ds->st_data[src], len);
+			return 0;
+		case IN_BFILL :
+			val = (uint8_t *)ds_pop(ds, sizeof(uint8_t));
+			if (val == NULL)
+				return 1;
+			if (arg & BULK_TOP) {
+				if ((uint64_t)ds->st_count + len >= ds->st_max)
+					return 1;
+				memset(&ds->st_data[ds->st_count], *val, len);
+				ds->st_count += len;
+				return 0;
+			}
+			if (bulk_pop(ds, &pos) || bulk_check(ds, pos, len))
+				return 1;
+			memset(&ds->st_data[pos], *val, len);
+			return 0;
+		case IN_BCMP :
+			if (bulk_pop(ds, &src) || bulk_pop(ds, &dst)
+				|| bulk_check(ds, src, len)
+				|| bulk_check(ds, dst, len))
+				return 1;
+			cmp = memcmp(&ds->st_data[src], &ds->st_data[dst], len);
+			/* discard previous comparison results */
+			vm_status->flags = (vm_status->flags >> 2) << 2;
+			vm_status->flags += (cmp < 0) ? FLAGS_COMP_LT :
+					((cmp > 0) ? FLAGS_COMP_GT : 0);
+			return 0;
+		case IN_BREV :
+			if (arg & BULK_TOP) {
+				if (len > ds->st_count)
+					return 1;
+				pos = ds->st_count - len;
+			} else if (bulk_pop(ds, &pos)
+					|| bulk_check(ds, pos, len))
+				return 1;
+			revmem(&ds->st_data[pos], len);
+			return 0;
+		default :
+			return 1;
+	}
+}
+
+/* Frame */
+int in_frame(vm_t *vm_status, uint8_t opcode, uint8_t arg)
+{
+	/* arg contains signed offset from frame pointer */
+	int64_t pos = (int64_t)vm_status->fp + (int8_t)arg;
+	uint32_t sz;
+	void *val;
+
+	switch (opcode) {
+		case IN_LDL_1 :
+		case IN_LDL_2 :
+		case IN_LDL_4 :
+		case IN_LDL_8 :
+			sz = 1 << (opcode - IN_LDL_1);
+			if ((pos < 0) || (pos + sz > vm_status->ds.st_count))
+				return 1;
+			return ds_pushraw(&vm_status->ds, sz,
+					&vm_status->ds.st_data[pos]);
+		case IN_STL_1 :
+		case IN_STL_2 :
+		case IN_STL_4 :
+		case IN_STL_8 :
+			sz = 1 << (opcode - IN_STL_1);
+			val = ds_pop(&vm_status->ds, sz);
+			if ((val == NULL) || (pos < 0)
+				|| (pos + sz > vm_status->ds.st_count))
+				return 1;
+			memcpy(&vm_status->ds.st_data[pos], val, sz);
+			return 0;
+		default :
+			return 1;
+	}
+}
+
+/* Linear memory */
+int in_mem(vm_t *vm_status, uint8_t opcode, uint8_t arg)
+{
+	uint32_t addr, sz;
+	void *ptr, *val;
+
+	switch (opcode) {
+		case IN_MLOAD :
+			if (bulk_pop(&vm_status->ds, &addr))
+				return 1;
+			ptr = lm_getelem(&vm_status->lm, addr, arg);
+			if (ptr == NULL)
+				return 1;
+			return ds_pushraw(&vm_status->ds, arg, ptr);
+		case IN_MSTORE :
+			if (bulk_pop(&vm_status->ds, &addr))
+				return 1;
+			ptr = lm_getelem(&vm_status->lm, addr, arg);
+			val = ds_pop(&vm_status->ds, arg);
+			if ((ptr == NULL) || (val == NULL))
+				return 1;
+			memcpy(ptr, val, arg);
+			return 0;
+		case IN_MSIZE :
+			sz = lm_size(&vm_status->lm);
+			return ds_pushraw(&vm_status->ds, sizeof(uint32_t), &sz);
+		case IN_MGROW :
+			if (bulk_pop(&vm_status->ds, &addr))
+				return 1;
+			sz = lm_size(&vm_status->lm);
+			if (lm_grow(&vm_status->lm, addr) != 0)
+				sz = 0xffffffff;
+			return ds_pushraw(&vm_status->ds, sizeof(uint32_t), &sz);
+		default :
+			return 1;
+	}
+}
+
 /* Artihmetical and logical */
+
+/* Integer operations of int_arith and int_logic */
+#define INT_ADD 0
+#define INT_SUB 1
+#define INT_MUL 2
+#define INT_DIV 3
+#define INT_MOD 4
+#define INT_AND 5
+#define INT_AND_L 6
+#define INT_OR 7
+#define INT_OR_L 8
+#define INT_XOR 9
+#define INT_XOR_L 10
+/* Set FLAGS_OVF by result of ADD, SUB or MUL */
+#define INT_OVF 0x80
+
+/* Integer helpers are specialized by operation at each use */
+#ifdef __GNUC__
+#define INT_INLINE static inline __attribute__((always_inline))
+#else
+#define INT_INLINE static inline
+#endif
+
+/* Integer sizes are powers of 2 up to INT_SZ_MAX */
+#define INT_SIZE_OK(sz) \
+	(((sz) != 0) && !((sz) & ((sz) - 1)) && ((sz) <= INT_SZ_MAX))
+
+/* Unsigned / signed integer of [sz] bytes at [ptr], extended
+ *
+ * Widest integers are copied, compiler may expect them aligned.
+ */
+INT_INLINE uint_wide_t int_getu(const void *ptr, uint32_t sz)
+{
+	uint_wide_t w;
+
+	switch (sz) {
+		case 1 : return *(const uint8_t *)ptr;
+		case 2 : return *(const uint16_t *)ptr;
+		case 4 : return *(const uint32_t *)ptr;
+		case 8 : return *(const uint64_t *)ptr;
+		default : memcpy(&w, ptr, sizeof(w)); return w;
+	}
+}
+
+INT_INLINE int_wide_t int_gets(const void *ptr, uint32_t sz)
+{
+	int_wide_t w;
+
+	switch (sz) {
+		case 1 : return *(const int8_t *)ptr;
+		case 2 : return *(const int16_t *)ptr;
+		case 4 : return *(const int32_t *)ptr;
+		case 8 : return *(const int64_t *)ptr;
+		default : memcpy(&w, ptr, sizeof(w)); return w;
+	}
+}
+
+/* Store [v] truncated to [sz] bytes at [ptr] */
+INT_INLINE void int_put(void *ptr, uint32_t sz, uint_wide_t v)
+{
+	switch (sz) {
+		case 1 : *(uint8_t *)ptr = v; break;
+		case 2 : *(uint16_t *)ptr = v; break;
+		case 4 : *(uint32_t *)ptr = v; break;
+		case 8 : *(uint64_t *)ptr = v; break;
+		default : memcpy(ptr, &v, sizeof(v));
+	}
+}
+
+/* Pop 2 integers of [sz] bytes, [pa] is head; result goes to [pb] */
+INT_INLINE int int_pop2(vm_t *vm_status, uint32_t sz, int sign, void **pb,
+		uint_wide_t *a, uint_wide_t *b)
+{
+	void *pa;
+
+	if (!INT_SIZE_OK(sz))
+		return 1;
+	pa = ds_pop(&vm_status->ds, sz);
+	*pb = ds_pop(&vm_status->ds, sz);
+	if ((pa == NULL) || (*pb == NULL))
+		return 1;
+
+	if (sign) {
+		*a = (uint_wide_t)int_gets(pa, sz);
+		*b = (uint_wide_t)int_gets(*pb, sz);
+	} else {
+		*a = int_getu(pa, sz);
+		*b = int_getu(*pb, sz);
+	}
+	return 0;
+}
+
+/* Quotient or remainder of [a] and nonzero [b] */
+INT_INLINE uint_wide_t int_div(uint_wide_t a, uint_wide_t b, uint32_t sz,
+		int sign, int quot)
+{
+	int_wide_t as = (int_wide_t)a, bs = (int_wide_t)b;
+
+	/* Minimal value / -1 overflows */
+	if (sign && (bs == -1))
+		return quot ? -a : 0;
+
+	/* Narrowest division that fits is the fastest one */
+	if (sz <= sizeof(uint32_t)) {
+		if (sign)
+			return (int_wide_t)(quot ? (int32_t)as / (int32_t)bs
+					: (int32_t)as % (int32_t)bs);
+		return quot ? (uint32_t)a / (uint32_t)b
+			: (uint32_t)a % (uint32_t)b;
+	}
+	if (sz <= sizeof(uint64_t)) {
+		if (sign)
+			return (int_wide_t)(quot ? (int64_t)as / (int64_t)bs
+					: (int64_t)as % (int64_t)bs);
+		return quot ? (uint64_t)a / (uint64_t)b
+			: (uint64_t)a % (uint64_t)b;
+	}
+	if (sign)
+		return quot ? as / bs : as % bs;
+	return quot ? a / b : a % b;
+}
+
+/* Whether (a op b) of integers as wide as uint_wide_t overflows */
+static int int_ovf_wide(int op, uint_wide_t a, uint_wide_t b, int sign)
+{
+	uint_wide_t c;
+	int_wide_t cs;
+
+	switch (op) {
+		case INT_ADD :
+			return sign ? __builtin_add_overflow((int_wide_t)a,
+					(int_wide_t)b, &cs)
+				: __builtin_add_overflow(a, b, &c);
+		case INT_SUB :
+			return sign ? __builtin_sub_overflow((int_wide_t)a,
+					(int_wide_t)b, &cs)
+				: __builtin_sub_overflow(a, b, &c);
+		default :
+			return sign ? __builtin_mul_overflow((int_wide_t)a,
+					(int_wide_t)b, &cs)
+				: __builtin_mul_overflow(a, b, &c);
+	}
+}
+
+/* Pop 2 integers of [sz] bytes and push (head op second) */
+INT_INLINE int int_arith(vm_t *vm_status, int op, uint32_t sz, int sign)
+{
+	uint_wide_t a, b, c;
+	uint32_t shift;
+	int ovf;
+	void *pb;
+
+	if (int_pop2(vm_status, sz, sign, &pb, &a, &b) != 0)
+		return 1;
+
+	switch (op & ~INT_OVF) {
+		case INT_ADD : c = a + b; break;
+		case INT_SUB : c = a - b; break;
+		case INT_MUL : c = a * b; break;
+		case INT_DIV :
+		case INT_MOD :
+			if (b == 0)
+				return 1;
+			c = int_div(a, b, sz, sign, op == INT_DIV);
+			break;
+		default : return 1;
+	}
+
+	if (op & INT_OVF) {
+		/* Narrower operands can't overflow wide result */
+		if (sz < sizeof(uint_wide_t)) {
+			shift = 8 * (sizeof(uint_wide_t) - sz);
+			ovf = sign ? (((int_wide_t)(c << shift) >> shift)
+					!= (int_wide_t)c)
+				: (((c << shift) >> shift) != c);
+		} else
+			ovf = int_ovf_wide(op & ~INT_OVF, a, b, sign);
+		if (ovf)
+			vm_status->flags |= FLAGS_OVF;
+		else
+			vm_status->flags &= ~FLAGS_OVF;
+	}
+
+	int_put(pb, sz, c);
+	vm_status->ds.st_count += sz;
+	return 0;
+}
+
+/* Pop 2 integers of [sz] bytes and push their product of 2 * [sz] bytes */
+static int int_mulw(vm_t *vm_status, uint32_t sz, int sign)
+{
+	uint_wide_t a, b;
+	void *pb;
+
+	if (!INT_SIZE_OK(2 * sz)
+		|| (int_pop2(vm_status, sz, sign, &pb, &a, &b) != 0))
+		return 1;
+
+	/* Second operand and head are adjacent, product covers both */
+	int_put(pb, 2 * sz, a * b);
+	vm_status->ds.st_count += 2 * sz;
+	return 0;
+}
+
+/* Bitwise and logical (0 or 1) operations on integers of [sz] bytes */
+static int int_logic(vm_t *vm_status, int op, uint32_t sz)
+{
+	uint_wide_t a, b, c;
+	void *pb;
+
+	/* Old programs leave size 0 */
+	if (sz == 0)
+		sz = 1;
+	if (int_pop2(vm_status, sz, 0, &pb, &a, &b) != 0)
+		return 1;
+
+	switch (op) {
+		case INT_AND : c = a & b; break;
+		case INT_AND_L : c = a && b; break;
+		case INT_OR : c = a | b; break;
+		case INT_OR_L : c = a || b; break;
+		case INT_XOR : c = a ^ b; break;
+		case INT_XOR_L : c = !!a ^ !!b; break;
+		default : return 1;
+	}
+
+	int_put(pb, sz, c);
+	vm_status->ds.st_count += sz;
+	return 0;
+}
+
+/* Pop value of [sz] bytes to [ptr] and 1-byte bit count below it to [n]
+ *
+ * Value is moved to place of the count, result is to be stored there.
+ */
+static int int_shift_pop(vm_t *vm_status, uint32_t sz, void **ptr,
+		uint8_t *n)
+{
+	uint8_t *cnt;
+
+	if (!INT_SIZE_OK(sz))
+		return 1;
+	*ptr = ds_pop(&vm_status->ds, sz);
+	cnt = (uint8_t *)ds_pop(&vm_status->ds, sizeof(uint8_t));
+	if ((*ptr == NULL) || (cnt == NULL))
+		return 1;
+
+	*n = *cnt;
+	memmove(cnt, *ptr, sz);
+	*ptr = cnt;
+	return 0;
+}
+
 int in_add(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 {
 	int ret;
-	uint8_t a1, b1, c1;
-	uint16_t a2, b2, c2;
-	uint32_t a4, b4, c4;
-	int8_t as1, bs1, cs1;
-	int16_t as2, bs2, cs2;
-	int32_t as4, bs4, cs4;
 	float fa, fb, fc;
 	double da, db, dc;
 	float fas, fbs, fcs;
@@ -145,68 +647,10 @@ int in_add(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 
 	switch (opcode) {
 		case IN_ADD_UI :
-			switch (arg) {
-				case 1 :
-					a1 = *(uint8_t *)ds_pop(&vm_status->ds,
-							sizeof(uint8_t));
-					b1 = *(uint8_t *)ds_pop(&vm_status->ds,
-							sizeof(uint8_t));
-					c1 = a1 + b1;
-					ret = ds_push(&vm_status->ds,
-							sizeof(uint8_t), &c1);
-					break;
-				case 2 :
-					a2 = *(uint16_t *)ds_pop(&vm_status->ds,
-							sizeof(uint16_t));
-					b2 = *(uint16_t *)ds_pop(&vm_status->ds,
-							sizeof(uint16_t));
-					c2 = htons(a2 + b2);
-					ret = ds_push(&vm_status->ds,
-							sizeof(uint16_t), &c2);
-					break;
-				case 4 :
-					a4 = *(uint32_t *)ds_pop(&vm_status->ds,
-							sizeof(uint32_t));
-					b4 = *(uint32_t *)ds_pop(&vm_status->ds,
-							sizeof(uint32_t));
-					c4 = htonl(a4 + b4);
-					ret = ds_push(&vm_status->ds,
-							sizeof(uint32_t), &c4);
-					break;
-				default : ret = 1;
-			}
+			ret = int_arith(vm_status, INT_ADD, arg, 0);
 			break;
 		case IN_ADD_SI :
-			switch (arg) {
-				case 1 :
-					as1 = *(int8_t *)ds_pop(&vm_status->ds,
-							sizeof(int8_t));
-					bs1 = *(int8_t *)ds_pop(&vm_status->ds,
-							sizeof(int8_t));
-					cs1 = as1 + bs1;
-					ret = ds_push(&vm_status->ds,
-							sizeof(int8_t), &cs1);
-					break;
-				case 2 :
-					as2 = *(int16_t *)ds_pop(&vm_status->ds,
-							sizeof(int16_t));
-					bs2 = *(int16_t *)ds_pop(&vm_status->ds,
-							sizeof(int16_t));
-					cs2 = (int16_t) htons(as2 + bs2);
-					ret = ds_push(&vm_status->ds,
-							sizeof(int16_t), &cs2);
-					break;
-				case 4 :
-					as4 = *(int32_t *)ds_pop(&vm_status->ds,
-							sizeof(int32_t));
-					bs4 = *(int32_t *)ds_pop(&vm_status->ds,
-							sizeof(int32_t));
-					cs4 = (int32_t) htonl(as4 + bs4);
-					ret = ds_push(&vm_status->ds,
-							sizeof(int32_t), &cs4);
-					break;
-				default : ret = 1;
-			}
+			ret = int_arith(vm_status, INT_ADD, arg, 1);
 			break;
 		case IN_ADD_UF :
 			switch (arg) {
@@ -218,7 +662,7 @@ int in_add(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 						ds_pop(&vm_status->ds,
 						sizeof(float));
 					fc = fa + fb;
-					ret = ds_push(&vm_status->ds,
+					ret = ds_pushraw(&vm_status->ds,
 						sizeof(float), &fc);
 					break;
 				case AUVMF_DOUBLE :
@@ -229,7 +673,7 @@ int in_add(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 						ds_pop(&vm_status->ds,
 						sizeof(double));
 					dc = da + db;
-					ret = ds_push(&vm_status->ds,
+					ret = ds_pushraw(&vm_status->ds,
 						sizeof(double), &dc);
 					break;
 				default : ret = 1;
@@ -245,7 +689,7 @@ int in_add(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 						ds_pop(&vm_status->ds,
 						sizeof(float));
 					fcs = fas + fbs;
-					ret = ds_push(&vm_status->ds,
+					ret = ds_pushraw(&vm_status->ds,
 						sizeof(float), &fcs);
 					break;
 				case AUVMF_DOUBLE :
@@ -256,7 +700,7 @@ int in_add(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 						ds_pop(&vm_status->ds,
 						sizeof(double));
 					dcs = das + dbs;
-					ret = ds_push(&vm_status->ds,
+					ret = ds_pushraw(&vm_status->ds,
 						sizeof(double), &dcs);
 					break;
 				default : ret = 1;
@@ -271,12 +715,6 @@ int in_add(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 int in_sub(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 {
 	int ret;
-	uint8_t a1, b1, c1;
-	uint16_t a2, b2, c2;
-	uint32_t a4, b4, c4;
-	int8_t as1, bs1, cs1;
-	int16_t as2, bs2, cs2;
-	int32_t as4, bs4, cs4;
 	float fa, fb, fc;
 	double da, db, dc;
 	float fas, fbs, fcs;
@@ -284,68 +722,10 @@ int in_sub(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 
 	switch (opcode) {
 		case IN_SUB_UI :
-			switch (arg) {
-				case 1 :
-					a1 = *(uint8_t *)ds_pop(&vm_status->ds,
-							sizeof(uint8_t));
-					b1 = *(uint8_t *)ds_pop(&vm_status->ds,
-							sizeof(uint8_t));
-					c1 = a1 - b1;
-					ret = ds_push(&vm_status->ds,
-							sizeof(uint8_t), &c1);
-					break;
-				case 2 :
-					a2 = *(uint16_t *)ds_pop(&vm_status->ds,
-							sizeof(uint16_t));
-					b2 = *(uint16_t *)ds_pop(&vm_status->ds,
-							sizeof(uint16_t));
-					c2 = htons(a2 - b2);
-					ret = ds_push(&vm_status->ds,
-							sizeof(uint16_t), &c2);
-					break;
-				case 4 :
-					a4 = *(uint32_t *)ds_pop(&vm_status->ds,
-							sizeof(uint32_t));
-					b4 = *(uint32_t *)ds_pop(&vm_status->ds,
-							sizeof(uint32_t));
-					c4 = htonl(a4 - b4);
-					ret = ds_push(&vm_status->ds,
-							sizeof(uint32_t), &c4);
-					break;
-				default : ret = 1;
-			}
+			ret = int_arith(vm_status, INT_SUB, arg, 0);
 			break;
 		case IN_SUB_SI :
-			switch (arg) {
-				case 1 :
-					as1 = *(int8_t *)ds_pop(&vm_status->ds,
-							sizeof(int8_t));
-					bs1 = *(int8_t *)ds_pop(&vm_status->ds,
-							sizeof(int8_t));
-					cs1 = as1 - bs1;
-					ret = ds_push(&vm_status->ds,
-							sizeof(int8_t), &cs1);
-					break;
-				case 2 :
-					as2 = *(int16_t *)ds_pop(&vm_status->ds,
-							sizeof(int16_t));
-					bs2 = *(int16_t *)ds_pop(&vm_status->ds,
-							sizeof(int16_t));
-					cs2 = (int16_t) htons(as2 - bs2);
-					ret = ds_push(&vm_status->ds,
-							sizeof(int16_t), &cs2);
-					break;
-				case 4 :
-					as4 = *(int32_t *)ds_pop(&vm_status->ds,
-							sizeof(int32_t));
-					bs4 = *(int32_t *)ds_pop(&vm_status->ds,
-							sizeof(int32_t));
-					cs4 = (int32_t) htonl(as4 - bs4);
-					ret = ds_push(&vm_status->ds,
-							sizeof(int32_t), &cs4);
-					break;
-				default : ret = 1;
-			}
+			ret = int_arith(vm_status, INT_SUB, arg, 1);
 			break;
 		case IN_SUB_UF :
 			switch (arg) {
@@ -357,7 +737,7 @@ int in_sub(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 						ds_pop(&vm_status->ds,
 						sizeof(float));
 					fc = fa - fb;
-					ret = ds_push(&vm_status->ds,
+					ret = ds_pushraw(&vm_status->ds,
 						sizeof(float), &fc);
 					break;
 				case AUVMF_DOUBLE :
@@ -368,7 +748,7 @@ int in_sub(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 						ds_pop(&vm_status->ds,
 						sizeof(double));
 					dc = da - db;
-					ret = ds_push(&vm_status->ds,
+					ret = ds_pushraw(&vm_status->ds,
 						sizeof(double), &dc);
 					break;
 				default : ret = 1;
@@ -384,7 +764,7 @@ int in_sub(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 						ds_pop(&vm_status->ds,
 						sizeof(float));
 					fcs = fas - fbs;
-					ret = ds_push(&vm_status->ds,
+					ret = ds_pushraw(&vm_status->ds,
 						sizeof(float), &fcs);
 					break;
 				case AUVMF_DOUBLE :
@@ -395,7 +775,7 @@ int in_sub(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 						ds_pop(&vm_status->ds,
 						sizeof(double));
 					dcs = das - dbs;
-					ret = ds_push(&vm_status->ds,
+					ret = ds_pushraw(&vm_status->ds,
 						sizeof(double), &dcs);
 					break;
 				default : ret = 1;
@@ -411,12 +791,6 @@ int in_sub(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 int in_mul(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 {
 	int ret;
-	uint8_t a1, b1, c1;
-	uint16_t a2, b2, c2;
-	uint32_t a4, b4, c4;
-	int8_t as1, bs1, cs1;
-	int16_t as2, bs2, cs2;
-	int32_t as4, bs4, cs4;
 	float fa, fb, fc;
 	double da, db, dc;
 	float fas, fbs, fcs;
@@ -424,68 +798,10 @@ int in_mul(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 
 	switch (opcode) {
 		case IN_MUL_UI :
-			switch (arg) {
-				case 1 :
-					a1 = *(uint8_t *)ds_pop(&vm_status->ds,
-							sizeof(uint8_t));
-					b1 = *(uint8_t *)ds_pop(&vm_status->ds,
-							sizeof(uint8_t));
-					c1 = a1 * b1;
-					ret = ds_push(&vm_status->ds,
-							sizeof(uint8_t), &c1);
-					break;
-				case 2 :
-					a2 = *(uint16_t *)ds_pop(&vm_status->ds,
-							sizeof(uint16_t));
-					b2 = *(uint16_t *)ds_pop(&vm_status->ds,
-							sizeof(uint16_t));
-					c2 = htons(a2 * b2);
-					ret = ds_push(&vm_status->ds,
-							sizeof(uint16_t), &c2);
-					break;
-				case 4 :
-					a4 = *(uint32_t *)ds_pop(&vm_status->ds,
-							sizeof(uint32_t));
-					b4 = *(uint32_t *)ds_pop(&vm_status->ds,
-							sizeof(uint32_t));
-					c4 = htonl(a4 * b4);
-					ret = ds_push(&vm_status->ds,
-							sizeof(uint32_t), &c4);
-					break;
-				default : ret = 1;
-			}
+			ret = int_arith(vm_status, INT_MUL, arg, 0);
 			break;
 		case IN_MUL_SI :
-			switch (arg) {
-				case 1 :
-					as1 = *(int8_t *)ds_pop(&vm_status->ds,
-							sizeof(int8_t));
-					bs1 = *(int8_t *)ds_pop(&vm_status->ds,
-							sizeof(int8_t));
-					cs1 = as1 * bs1;
-					ret = ds_push(&vm_status->ds,
-							sizeof(int8_t), &cs1);
-					break;
-				case 2 :
-					as2 = *(int16_t *)ds_pop(&vm_status->ds,
-							sizeof(int16_t));
-					bs2 = *(int16_t *)ds_pop(&vm_status->ds,
-							sizeof(int16_t));
-					cs2 = (int16_t) htons(as2 * bs2);
-					ret = ds_push(&vm_status->ds,
-							sizeof(int16_t), &cs2);
-					break;
-				case 4 :
-					as4 = *(int32_t *)ds_pop(&vm_status->ds,
-							sizeof(int32_t));
-					bs4 = *(int32_t *)ds_pop(&vm_status->ds,
-							sizeof(int32_t));
-					cs4 = (int32_t) htonl(as4 * bs4);
-					ret = ds_push(&vm_status->ds,
-							sizeof(int32_t), &cs4);
-					break;
-				default : ret = 1;
-			}
+			ret = int_arith(vm_status, INT_MUL, arg, 1);
 			break;
 		case IN_MUL_UF :
 			switch (arg) {
@@ -497,7 +813,7 @@ int in_mul(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 						ds_pop(&vm_status->ds,
 						sizeof(float));
 					fc = fa * fb;
-					ret = ds_push(&vm_status->ds,
+					ret = ds_pushraw(&vm_status->ds,
 						sizeof(float), &fc);
 					break;
 				case AUVMF_DOUBLE :
@@ -508,7 +824,7 @@ int in_mul(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 						ds_pop(&vm_status->ds,
 						sizeof(double));
 					dc = da * db;
-					ret = ds_push(&vm_status->ds,
+					ret = ds_pushraw(&vm_status->ds,
 						sizeof(double), &dc);
 					break;
 				default : ret = 1;
@@ -524,7 +840,7 @@ int in_mul(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 						ds_pop(&vm_status->ds,
 						sizeof(float));
 					fcs = fas * fbs;
-					ret = ds_push(&vm_status->ds,
+					ret = ds_pushraw(&vm_status->ds,
 						sizeof(float), &fcs);
 					break;
 				case AUVMF_DOUBLE :
@@ -535,7 +851,7 @@ int in_mul(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 						ds_pop(&vm_status->ds,
 						sizeof(double));
 					dcs = das * dbs;
-					ret = ds_push(&vm_status->ds,
+					ret = ds_pushraw(&vm_status->ds,
 						sizeof(double), &dcs);
 					break;
 				default : ret = 1;
@@ -550,12 +866,6 @@ int in_mul(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 int in_div(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 {
 	int ret;
-	uint8_t a1, b1, c1;
-	uint16_t a2, b2, c2;
-	uint32_t a4, b4, c4;
-	int8_t as1, bs1, cs1;
-	int16_t as2, bs2, cs2;
-	int32_t as4, bs4, cs4;
 	float fa, fb, fc;
 	double da, db, dc;
 	float fas, fbs, fcs;
@@ -563,68 +873,10 @@ int in_div(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 
 	switch (opcode) {
 		case IN_DIV_UI :
-			switch (arg) {
-				case 1 :
-					a1 = *(uint8_t *)ds_pop(&vm_status->ds,
-							sizeof(uint8_t));
-					b1 = *(uint8_t *)ds_pop(&vm_status->ds,
-							sizeof(uint8_t));
-					c1 = a1 / b1;
-					ret = ds_push(&vm_status->ds,
-							sizeof(uint8_t), &c1);
-					break;
-				case 2 :
-					a2 = *(uint16_t *)ds_pop(&vm_status->ds,
-							sizeof(uint16_t));
-					b2 = *(uint16_t *)ds_pop(&vm_status->ds,
-							sizeof(uint16_t));
-					c2 = htons(a2 / b2);
-					ret = ds_push(&vm_status->ds,
-							sizeof(uint16_t), &c2);
-					break;
-				case 4 :
-					a4 = *(uint32_t *)ds_pop(&vm_status->ds,
-							sizeof(uint32_t));
-					b4 = *(uint32_t *)ds_pop(&vm_status->ds,
-							sizeof(uint32_t));
-					c4 = htonl(a4 / b4);
-					ret = ds_push(&vm_status->ds,
-							sizeof(uint32_t), &c4);
-					break;
-				default : ret = 1;
-			}
+			ret = int_arith(vm_status, INT_DIV, arg, 0);
 			break;
 		case IN_DIV_SI :
-			switch (arg) {
-				case 1 :
-					as1 = *(int8_t *)ds_pop(&vm_status->ds,
-							sizeof(int8_t));
-					bs1 = *(int8_t *)ds_pop(&vm_status->ds,
-							sizeof(int8_t));
-					cs1 = as1 / bs1;
-					ret = ds_push(&vm_status->ds,
-							sizeof(int8_t), &cs1);
-					break;
-				case 2 :
-					as2 = *(int16_t *)ds_pop(&vm_status->ds,
-							sizeof(int16_t));
-					bs2 = *(int16_t *)ds_pop(&vm_status->ds,
-							sizeof(int16_t));
-					cs2 = (int16_t) htons(as2 / bs2);
-					ret = ds_push(&vm_status->ds,
-							sizeof(int16_t), &cs2);
-					break;
-				case 4 :
-					as4 = *(int32_t *)ds_pop(&vm_status->ds,
-							sizeof(int32_t));
-					bs4 = *(int32_t *)ds_pop(&vm_status->ds,
-							sizeof(int32_t));
-					cs4 = (int32_t) htonl(as4 / bs4);
-					ret = ds_push(&vm_status->ds,
-							sizeof(int32_t), &cs4);
-					break;
-				default : ret = 1;
-			}
+			ret = int_arith(vm_status, INT_DIV, arg, 1);
 			break;
 		case IN_DIV_UF :
 			switch (arg) {
@@ -636,7 +888,7 @@ int in_div(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 						ds_pop(&vm_status->ds,
 						sizeof(float));
 					fc = fa / fb;
-					ret = ds_push(&vm_status->ds,
+					ret = ds_pushraw(&vm_status->ds,
 						sizeof(float), &fc);
 					break;
 				case AUVMF_DOUBLE :
@@ -647,7 +899,7 @@ int in_div(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 						ds_pop(&vm_status->ds,
 						sizeof(double));
 					dc = da / db;
-					ret = ds_push(&vm_status->ds,
+					ret = ds_pushraw(&vm_status->ds,
 						sizeof(double), &dc);
 					break;
 				default : ret = 1;
@@ -663,7 +915,7 @@ int in_div(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 						ds_pop(&vm_status->ds,
 						sizeof(float));
 					fcs = fas / fbs;
-					ret = ds_push(&vm_status->ds,
+					ret = ds_pushraw(&vm_status->ds,
 						sizeof(float), &fcs);
 					break;
 				case AUVMF_DOUBLE :
@@ -674,7 +926,7 @@ int in_div(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 						ds_pop(&vm_status->ds,
 						sizeof(double));
 					dcs = das / dbs;
-					ret = ds_push(&vm_status->ds,
+					ret = ds_pushraw(&vm_status->ds,
 						sizeof(double), &dcs);
 					break;
 				default : ret = 1;
@@ -688,186 +940,148 @@ int in_div(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 
 int in_mod(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 {
-	int ret;
-	uint8_t a1, b1, c1;
-	uint16_t a2, b2, c2;
-	uint32_t a4, b4, c4;
-	int8_t as1, bs1, cs1;
-	int16_t as2, bs2, cs2;
-	int32_t as4, bs4, cs4;
-
 	switch (opcode) {
-		case IN_ADD_UI :
-			switch (arg) {
-				case 1 :
-					a1 = *(uint8_t *)ds_pop(&vm_status->ds,
-							sizeof(uint8_t));
-					b1 = *(uint8_t *)ds_pop(&vm_status->ds,
-							sizeof(uint8_t));
-					c1 = a1 % b1;
-					ret = ds_push(&vm_status->ds,
-							sizeof(uint8_t), &c1);
-					break;
-				case 2 :
-					a2 = *(uint16_t *)ds_pop(&vm_status->ds,
-							sizeof(uint16_t));
-					b2 = *(uint16_t *)ds_pop(&vm_status->ds,
-							sizeof(uint16_t));
-					c2 = htons(a2 % b2);
-					ret = ds_push(&vm_status->ds,
-							sizeof(uint16_t), &c2);
-					break;
-				case 4 :
-					a4 = *(uint32_t *)ds_pop(&vm_status->ds,
-							sizeof(uint32_t));
-					b4 = *(uint32_t *)ds_pop(&vm_status->ds,
-							sizeof(uint32_t));
-					c4 = htonl(a4 % b4);
-					ret = ds_push(&vm_status->ds,
-							sizeof(uint32_t), &c4);
-					break;
-				default : ret = 1;
-			}
-			break;
-		case IN_ADD_SI :
-			switch (arg) {
-				case 1 :
-					as1 = *(int8_t *)ds_pop(&vm_status->ds,
-							sizeof(int8_t));
-					bs1 = *(int8_t *)ds_pop(&vm_status->ds,
-							sizeof(int8_t));
-					cs1 = as1 % bs1;
-					ret = ds_push(&vm_status->ds,
-							sizeof(int8_t), &cs1);
-					break;
-				case 2 :
-					as2 = *(int16_t *)ds_pop(&vm_status->ds,
-							sizeof(int16_t));
-					bs2 = *(int16_t *)ds_pop(&vm_status->ds,
-							sizeof(int16_t));
-					cs2 = (int16_t) htons(as2 % bs2);
-					ret = ds_push(&vm_status->ds,
-							sizeof(int16_t), &cs2);
-					break;
-				case 4 :
-					as4 = *(int32_t *)ds_pop(&vm_status->ds,
-							sizeof(int32_t));
-					bs4 = *(int32_t *)ds_pop(&vm_status->ds,
-							sizeof(int32_t));
-					cs4 = (int32_t) htonl(as4 % bs4);
-					ret = ds_push(&vm_status->ds,
-							sizeof(int32_t), &cs4);
-					break;
-				default : ret = 1;
-			}
-			break;
-		default : ret = 1;
+		case IN_MOD_UI : return int_arith(vm_status, INT_MOD, arg, 0);
+		case IN_MOD_SI : return int_arith(vm_status, INT_MOD, arg, 1);
+		default : return 1;
 	}
+}
 
-	return ret;
+int in_and(vm_t *vm_status, uint8_t opcode, uint8_t arg)
+{
+	switch (opcode) {
+		case IN_AND : return int_logic(vm_status, INT_AND, arg);
+		case IN_AND_L : return int_logic(vm_status, INT_AND_L, arg);
+		default : return 1;
+	}
 }
 
-int in_and(vm_t *vm_status, uint8_t opcode, uint8_t UNUSED(arg))
+int in_or(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 {
-	int ret;
-	uint8_t a, b, c;
+	switch (opcode) {
+		case IN_OR : return int_logic(vm_status, INT_OR, arg);
+		case IN_OR_L : return int_logic(vm_status, INT_OR_L, arg);
+		default : return 1;
+	}
+}
 
+int in_xor(vm_t *vm_status, uint8_t opcode, uint8_t arg)
+{
 	switch (opcode) {
-		case IN_AND :
-			a = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			b = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			c = a & b;
-			ret = ds_push(&vm_status->ds, sizeof(uint8_t), &c);
-			break;
-		case IN_AND_L :
-			a = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			b = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			c = a && b;
-			ret = ds_push(&vm_status->ds, sizeof(uint8_t), &c);
-			break;
-		default : ret = 1;
+		case IN_XOR : return int_logic(vm_status, INT_XOR, arg);
+		case IN_XOR_L : return int_logic(vm_status, INT_XOR_L, arg);
+		default : return 1;
 	}
+}
 
-	return ret;
+int in_not(vm_t *vm_status, uint8_t opcode, uint8_t arg)
+{
+	uint_wide_t a;
+	void *ptr;
+
+	/* Old programs leave size 0 */
+	if (arg == 0)
+		arg = 1;
+	if (!INT_SIZE_OK(arg))
+		return 1;
+	ptr = ds_pop(&vm_status->ds, arg);
+	if (ptr == NULL)
+		return 1;
+	a = int_getu(ptr, arg);
+
+	switch (opcode) {
+		case IN_NOT : int_put(ptr, arg, ~a); break;
+		case IN_NOT_L : int_put(ptr, arg, !a); break;
+		default : return 1;
+	}
+	vm_status->ds.st_count += arg;
+	return 0;
 }
 
-int in_or(vm_t *vm_status, uint8_t opcode, uint8_t UNUSED(arg))
+/* Shift and rotation, bit count is 1-byte argument below the value */
+int in_shl(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 {
-	int ret;
-	uint8_t a, b, c;
+	uint_wide_t a;
+	uint32_t bits = 8 * arg;
+	uint8_t n;
+	void *ptr;
+
+	if (int_shift_pop(vm_status, arg, &ptr, &n) != 0)
+		return 1;
+	a = int_getu(ptr, arg);
 
 	switch (opcode) {
-		case IN_OR :
-			a = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			b = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			c = a | b;
-			ret = ds_push(&vm_status->ds, sizeof(uint8_t), &c);
+		case IN_SHL :
+			a = (n < bits) ? (a << n) : 0;
 			break;
-		case IN_OR_L :
-			a = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			b = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			c = a || b;
-			ret = ds_push(&vm_status->ds, sizeof(uint8_t), &c);
+		case IN_ROTL :
+			n %= bits;
+			if (n != 0)
+				a = (a << n) | (a >> (bits - n));
 			break;
-		default : ret = 1;
+		default : return 1;
 	}
-
-	return ret;
+	int_put(ptr, arg, a);
+	vm_status->ds.st_count += arg;
+	return 0;
 }
 
-int in_xor(vm_t *vm_status, uint8_t opcode, uint8_t UNUSED(arg))
+int in_shr(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 {
-	int ret;
-	uint8_t a, b, c;
+	uint_wide_t a;
+	uint32_t bits = 8 * arg;
+	uint8_t n;
+	void *ptr;
+
+	if (int_shift_pop(vm_status, arg, &ptr, &n) != 0)
+		return 1;
+	a = int_getu(ptr, arg);
 
 	switch (opcode) {
-		case IN_XOR :
-			a = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			b = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			c = a ^ b;
-			ret = ds_push(&vm_status->ds, sizeof(uint8_t), &c);
+		case IN_SHR :
+			a = (n < bits) ? (a >> n) : 0;
 			break;
-		case IN_XOR_L :
-			a = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			b = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			c = !!a ^ !!b;
-			ret = ds_push(&vm_status->ds, sizeof(uint8_t), &c);
+		case IN_ROTR :
+			n %= bits;
+			if (n != 0)
+				a = (a >> n) | (a << (bits - n));
 			break;
-		default : ret = 1;
+		default : return 1;
 	}
-
-	return ret;
+	int_put(ptr, arg, a);
+	vm_status->ds.st_count += arg;
+	return 0;
 }
 
-int in_not(vm_t *vm_status, uint8_t opcode, uint8_t UNUSED(arg))
+/* Overflow checking and widening integer arithmetic */
+int in_wide(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 {
 	int ret;
-	uint8_t a, b;
 
 	switch (opcode) {
-		case IN_NOT :
-			a = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			b = ~a;
-			ret = ds_push(&vm_status->ds, sizeof(uint8_t), &b);
+		case IN_ADDO_UI :
+			ret = int_arith(vm_status, INT_ADD | INT_OVF, arg, 0);
+			break;
+		case IN_ADDO_SI :
+			ret = int_arith(vm_status, INT_ADD | INT_OVF, arg, 1);
 			break;
-		case IN_NOT_L :
-			a = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			b = !a;
-			ret = ds_push(&vm_status->ds, sizeof(uint8_t), &b);
+		case IN_SUBO_UI :
+			ret = int_arith(vm_status, INT_SUB | INT_OVF, arg, 0);
+			break;
+		case IN_SUBO_SI :
+			ret = int_arith(vm_status, INT_SUB | INT_OVF, arg, 1);
+			break;
+		case IN_MULO_UI :
+			ret = int_arith(vm_status, INT_MUL | INT_OVF, arg, 0);
+			break;
+		case IN_MULO_SI :
+			ret = int_arith(vm_status, INT_MUL | INT_OVF, arg, 1);
+			break;
+		case IN_MULW_UI :
+			ret = int_mulw(vm_status, arg, 0);
+			break;
+		case IN_MULW_SI :
+			ret = int_mulw(vm_status, arg, 1);
 			break;
 		default : ret = 1;
 	}
@@ -875,52 +1089,152 @@ int in_not(vm_t *vm_status, uint8_t opcode, uint8_t UNUSED(arg))
 	return ret;
 }
 
-int in_shl(vm_t *vm_status, uint8_t opcode, uint8_t arg)
-{
-	int ret;
-	uint8_t a, b;
+/* Conversions */
 
+/* Round [x] to integral value by CVT opcode, plain CVT truncates */
+static double cvt_round(uint8_t opcode, double x)
+{
 	switch (opcode) {
-		case IN_SHL :
-			a = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			b = a << arg;
-			ret = ds_push(&vm_status->ds, sizeof(uint8_t), &b);
-			break;
-		case IN_ROTL :
-			a = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			b = (a << arg) | (a >> (sizeof(uint8_t) * 8 - arg));
-			ret = ds_push(&vm_status->ds, sizeof(uint8_t), &b);
-			break;
-		default : ret = 1;
+		case IN_CVT_RN : return nearbyint(x);
+		case IN_CVT_RD : return floor(x);
+		case IN_CVT_RU : return ceil(x);
+		default : return trunc(x);
 	}
+}
 
-	return ret;
+/* Size of value described by CVT_FLAGS [f], 0 if they are invalid */
+static uint32_t cvt_size(uint8_t f)
+{
+	switch (CMP_FMT(f)) {
+		case AUVMF_UINT :
+		case AUVMF_SINT :
+			return INT_SIZE_OK(CMP_SIZE(f)) ? CMP_SIZE(f) : 0;
+		case AUVMF_FLOAT : return sizeof(float);
+		case AUVMF_DOUBLE : return sizeof(double);
+		default : return 0;
+	}
 }
 
-int in_shr(vm_t *vm_status, uint8_t opcode, uint8_t arg)
+/* Integer [v] (negative if [neg]) to integer of CVT_FLAGS [dst] */
+static uint_wide_t cvt_int(uint_wide_t v, int neg, uint8_t dst)
 {
-	int ret;
-	uint8_t a, b;
+	uint32_t bits = 8 * CMP_SIZE(dst);
+	uint_wide_t max;
+
+	if (!(dst & CVT_SAT))
+		return v;
+
+	/* Largest value of destination, smallest is -max - 1 if signed */
+	max = (uint_wide_t)-1 >> (8 * sizeof(uint_wide_t) - bits);
+	if (CMP_FMT(dst) == AUVMF_SINT) {
+		max >>= 1;
+		if (neg)
+			return ((int_wide_t)v < -(int_wide_t)max - 1)
+				? ~max : v;
+	} else if (neg) {
+		return 0;
+	}
+	return (v > max) ? max : v;
+}
 
-	switch (opcode) {
-		case IN_SHR :
-			a = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			b = a >> arg;
-			ret = ds_push(&vm_status->ds, sizeof(uint8_t), &b);
-			break;
-		case IN_ROTR :
-			a = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			b = (a >> arg) | (a << (sizeof(uint8_t) * 8 - arg));
-			ret = ds_push(&vm_status->ds, sizeof(uint8_t), &b);
+/* Integral [x] to integer of CVT_FLAGS [dst], nonzero if out of range */
+static int cvt_fint(double x, uint8_t dst, uint_wide_t *v)
+{
+	uint32_t bits = 8 * CMP_SIZE(dst);
+	double lo = 0.0, hi = ldexp(1.0, bits);
+
+	if (CMP_FMT(dst) == AUVMF_SINT) {
+		hi = ldexp(1.0, bits - 1);
+		lo = -hi;
+	}
+
+	if (!(x >= lo) || !(x < hi)) {
+		if (!(dst & CVT_SAT))
+			return 1;
+		/* NaN saturates to 0 */
+		if (x >= hi) {
+			*v = cvt_int((uint_wide_t)-1, 0, dst);
+			return 0;
+		}
+		x = (x < lo) ? lo : 0.0;
+	}
+
+	if (CMP_FMT(dst) == AUVMF_SINT)
+		*v = (uint_wide_t)(int_wide_t)x;
+	else
+		*v = (uint_wide_t)x;
+	return 0;
+}
+
+int in_cvt(vm_t *vm_status, uint8_t opcode, uint8_t arg)
+{
+	uint8_t dst = vm_status->ctbl[vm_status->cip.obj]
+		.data[vm_status->cip.addr + 2];
+	uint32_t ssz = cvt_size(arg), dsz = cvt_size(dst);
+	uint_wide_t v;
+	int_wide_t sv;
+	double x = 0.0;
+	float f;
+	void *ptr;
+
+	vm_status->nip.addr += 1;
+	if (!ssz || !dsz)
+		return 1;
+	ptr = ds_pop(&vm_status->ds, ssz);
+	if (ptr == NULL)
+		return 1;
+
+	switch (CMP_FMT(arg)) {
+		case AUVMF_UINT :
+			v = int_getu(ptr, ssz);
+			switch (CMP_FMT(dst)) {
+				case AUVMF_FLOAT : f = v; goto push_float;
+				case AUVMF_DOUBLE : x = v; goto push_double;
+				default : v = cvt_int(v, 0, dst); goto push_int;
+			}
+		case AUVMF_SINT :
+			sv = int_gets(ptr, ssz);
+			switch (CMP_FMT(dst)) {
+				case AUVMF_FLOAT : f = sv; goto push_float;
+				case AUVMF_DOUBLE : x = sv; goto push_double;
+				default :
+					v = cvt_int(sv, sv < 0, dst);
+					goto push_int;
+			}
+		case AUVMF_FLOAT :
+			x = *(float *)ptr;
 			break;
-		default : ret = 1;
+		default :
+			x = *(double *)ptr;
 	}
 
-	return ret;
+	/* Floating point source */
+	if ((opcode != IN_CVT) || ((CMP_FMT(dst) != AUVMF_FLOAT)
+			&& (CMP_FMT(dst) != AUVMF_DOUBLE)))
+		x = cvt_round(opcode, x);
+
+	switch (CMP_FMT(dst)) {
+		case AUVMF_FLOAT :
+			f = x;
+			goto push_float;
+		case AUVMF_DOUBLE :
+			goto push_double;
+		default :
+			if (cvt_fint(x, dst, &v) != 0)
+				return 1;
+			goto push_int;
+	}
+
+push_float:
+	/* Finite values saturate to largest float instead of infinity */
+	if ((dst & CVT_SAT) && isinf(f) && !isinf(x))
+		f = (f < 0) ? -FLT_MAX : FLT_MAX;
+	return ds_pushraw(&vm_status->ds, sizeof(float), &f);
+push_double:
+	return ds_pushraw(&vm_status->ds, sizeof(double), &x);
+push_int:
+	int_put(&sv, dsz, v);
+	return ds_pushraw(&vm_status->ds, dsz, &sv);
 }
 
 /* Branching */
@@ -929,17 +1243,20 @@ int in_jmp(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 {
 	int ret = 0;
 	int32_t offset;
-	uint32_t addr, obj;
+	uint32_t addr = 0, obj = 0;
+	const uint8_t *code;
+	frame_t frame;
 
-	if ((opcode == IN_CALL) || (opcode == IN_CALL_L))
-		/* save NIP */
-		ret += cs_push(&vm_status->cs, &vm_status->nip);
+	/* save NIP and FP */
+	frame.ret = vm_status->nip;
+	frame.fp = vm_status->fp;
+	memcpy(frame.lc, vm_status->lc, sizeof(frame.lc));
 
 	switch (opcode) {
 		/* Object-wise jumps / calls */
 		case IN_JMP :
 		case IN_CALL :
-			switch (arg) {
+			switch ((opcode == IN_CALL) ? (arg & ~CALL_FRAME) : arg) {
 				case JMP_REL :
 					/* Relative jump */
 					offset = *(int32_t *)
@@ -964,24 +1281,76 @@ int in_jmp(vm_t *vm_status, uint8_t opcode, uint8_t arg)
 						sizeof(uint32_t));
 			obj = *(uint32_t *)ds_pop(&vm_status->ds,
 						sizeof(uint32_t));
-			if (vm_status->obj_count <= obj)
-				/* Illegal object */
+			break;
+		/* Direct long jumps / calls, target follows instruction */
+		case IN_JMP_D :
+		case IN_CALL_D :
+			code = &vm_status->ctbl[vm_status->cip.obj]
+				.data[vm_status->cip.addr + 2];
+			memcpy(&obj, code, sizeof(uint32_t));
+			memcpy(&addr, code + sizeof(uint32_t),
+					sizeof(uint32_t));
+			obj = ntohl(obj);
+			addr = ntohl(addr);
+			frame.ret.addr += 3 * sizeof(uint32_t);
+			break;
+		/* Relative jumps / calls, offset in instruction */
+		case IN_JMPI :
+			vm_status->nip.addr += (int8_t)arg;
+			break;
+		case IN_JMPW :
+		case IN_CALLW :
+			if ((opcode == IN_CALLW) && (arg & ~CALL_FRAME)) {
 				ret++;
-			else {
-				/* Update NIP */
-				vm_status->nip.addr = addr;
-				vm_status->nip.obj = obj;
+				break;
 			}
+			code = &vm_status->ctbl[vm_status->cip.obj]
+				.data[vm_status->cip.addr + 2];
+			memcpy(&offset, code, sizeof(int32_t));
+			frame.ret.addr += sizeof(int32_t);
+			vm_status->nip.addr += sizeof(int32_t)
+				+ (int32_t)ntohl(offset);
 			break;
 		default : ret++;
 	}
 
+	if ((ret == 0) && ((opcode == IN_JMP_L) || (opcode == IN_CALL_L)
+		|| (opcode == IN_JMP_D) || (opcode == IN_CALL_D))) {
+		if ((vm_status->obj_count <= obj)
+			|| (obj_require(&vm_status->ctbl[obj]) != 0))
+			/* Illegal object or it can't be loaded */
+			ret++;
+		else {
+			/* Update NIP */
+			vm_status->nip.addr = addr;
+			vm_status->nip.obj = obj;
+		}
+	}
+
+	/* Target must be an instruction of (loaded) object */
+	if ((ret == 0) && !obj_target(&vm_status->ctbl[vm_status->nip.obj],
+				vm_status->nip.addr))
+		ret++;
+
+	if ((opcode == IN_CALL) || (opcode == IN_CALL_L)
+		|| (opcode == IN_CALL_D) || (opcode == IN_CALLW)) {
+		frame.entry = vm_status->nip;
+		if (cs_push(&vm_status->cs, &frame) != 0)
+			ret++;
+		else memset(&vm_status->rf[REG_COUNT
+			* vm_status->cs.st_count], 0,
+			sizeof(uint64_t) * REG_COUNT);
+		/* New frame starts above the popped call target */
+		if (arg & CALL_FRAME)
+			vm_status->fp = vm_status->ds.st_count;
+	}
+
 	return ret;
 }
 
 int in_ret(vm_t *vm_status, uint8_t UNUSED(opcode), uint8_t arg)
 {
-	ip_t *tmp;
+	frame_t *tmp = NULL;
 
 	/* Argument contains number of levels to return from */
 	while (arg--) {
@@ -990,65 +1359,149 @@ int in_ret(vm_t *vm_status, uint8_t UNUSED(opcode), uint8_t arg)
 	if (tmp == NULL)
 		return 1;
 
-	vm_status->nip.addr = tmp->addr;
-	vm_status->nip.obj = tmp->obj;
+	vm_status->nip.addr = tmp->ret.addr;
+	vm_status->nip.obj = tmp->ret.obj;
+	vm_status->fp = tmp->fp;
+	memcpy(vm_status->lc, tmp->lc, sizeof(vm_status->lc));
 
 	return 0;
 }
 
+int in_switch(vm_t *vm_status, uint8_t UNUSED(opcode), uint8_t arg)
+{
+	const uint8_t *table;
+	uint32_t count = arg ? arg : 256, idx, off;
+	void *ptr;
+
+	ptr = ds_pop(&vm_status->ds, sizeof(uint32_t));
+	if (ptr == NULL)
+		return 1;
+	idx = *(uint32_t *)ptr;
+
+	/* Entry 0 is default, index i is at i + 1 */
+	table = &vm_status->ctbl[vm_status->cip.obj]
+		.data[vm_status->cip.addr + 2];
+	memcpy(&off, &table[sizeof(uint32_t) * ((idx < count) ? idx + 1 : 0)],
+			sizeof(uint32_t));
+	vm_status->nip.addr += sizeof(uint32_t) * (count + 1)
+		+ (int32_t)ntohl(off);
+
+	if (!obj_target(&vm_status->ctbl[vm_status->nip.obj],
+				vm_status->nip.addr))
+		return 1;
+	return 0;
+}
+
+int in_loop(vm_t *vm_status, uint8_t opcode, uint8_t arg)
+{
+	int32_t offset;
+	void *ptr;
+
+	if (arg >= LOOP_REGS)
+		return 1;
+
+	switch (opcode) {
+		case IN_LOOP :
+			ptr = ds_pop(&vm_status->ds, sizeof(uint32_t));
+			if (ptr == NULL)
+				return 1;
+			vm_status->lc[arg] = *(uint32_t *)ptr;
+			if (vm_status->lc[arg] != 0)
+				break;
+			goto take;
+		case IN_NEXT :
+			if (--vm_status->lc[arg] != 0)
+				goto take;
+			break;
+		default :
+			return 1;
+	}
+	vm_status->nip.addr += sizeof(int32_t);
+	return 0;
+
+take:
+	memcpy(&offset, &vm_status->ctbl[vm_status->cip.obj]
+			.data[vm_status->cip.addr + 2], sizeof(int32_t));
+	vm_status->nip.addr += sizeof(int32_t) + (int32_t)ntohl(offset);
+	if (!obj_target(&vm_status->ctbl[vm_status->nip.obj],
+				vm_status->nip.addr))
+		return 1;
+	return 0;
+}
+
 /* Conditionals */
 
-int in_cmp(vm_t *vm_status, uint8_t UNUSED(opcode), uint8_t arg)
+/* Pop 2 arguments described by CMP_FLAGS [arg] and compare them
+ *
+ * Returns FLAGS_COMP_* bits for (first op second), -1 on error.
+ */
+static int cmp_pop(vm_t *vm_status, uint8_t arg)
 {
-	int ret = 0;
-	uint8_t a, b;
-	int8_t as, bs;
+	uint32_t sz;
+	void *pa, *pb;
+	uint_wide_t a, b;
+	int_wide_t as, bs;
 	float fa, fb;
 	double da, db;
-	
-	/* discard previous comparison results */
-	vm_status->flags = (vm_status->flags >> 2) << 2;
 
-	switch (arg) {
+	switch (CMP_FMT(arg)) {
 		case AUVMF_UINT :
-			a = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			b = *(uint8_t *)ds_pop(&vm_status->ds,
-						sizeof(uint8_t));
-			vm_status->flags += (a < b) ? FLAGS_COMP_LT : 
-					((a > b) ? FLAGS_COMP_GT : 0);
-			break;
 		case AUVMF_SINT :
-			as = *(int8_t *)ds_pop(&vm_status->ds,
-						sizeof(int8_t));
-			bs = *(int8_t *)ds_pop(&vm_status->ds,
-						sizeof(int8_t));
-			vm_status->flags += (as < bs) ? FLAGS_COMP_LT : 
-					((as > bs) ? FLAGS_COMP_GT : 0);
+			sz = CMP_SIZE(arg);
+			if (sz > INT_SZ_MAX)
+				return -1;
 			break;
+		case AUVMF_FLOAT : sz = sizeof(float); break;
+		case AUVMF_DOUBLE : sz = sizeof(double); break;
+		default : return -1;
+	}
+
+	pa = ds_pop(&vm_status->ds, sz);
+	pb = ds_pop(&vm_status->ds, sz);
+	if ((pa == NULL) || (pb == NULL))
+		return -1;
+
+	switch (CMP_FMT(arg)) {
+		case AUVMF_UINT :
+			a = int_getu(pa, sz);
+			b = int_getu(pb, sz);
+			return (a < b) ? FLAGS_COMP_LT :
+				((a > b) ? FLAGS_COMP_GT : 0);
+		case AUVMF_SINT :
+			as = int_gets(pa, sz);
+			bs = int_gets(pb, sz);
+			return (as < bs) ? FLAGS_COMP_LT :
+				((as > bs) ? FLAGS_COMP_GT : 0);
 		case AUVMF_FLOAT :
-			fa = *(float *)ds_pop(&vm_status->ds,
-						sizeof(float));
-			fb = *(float *)ds_pop(&vm_status->ds,
-						sizeof(float));
-			vm_status->flags += (fa < fb) ? FLAGS_COMP_LT : 
-					((fa > fb) ? FLAGS_COMP_GT : 0);
-			break;
-		case AUVMF_DOUBLE :
-			da = *(double *)ds_pop(&vm_status->ds,
-						sizeof(double));
-			db = *(double *)ds_pop(&vm_status->ds,
-						sizeof(double));
-			vm_status->flags += (da < db) ? FLAGS_COMP_LT : 
-					((da > db) ? FLAGS_COMP_GT : 0);
-			break;
-		default : ret = 1;
+			memcpy(&fa, pa, sz);
+			memcpy(&fb, pb, sz);
+			return (fa < fb) ? FLAGS_COMP_LT :
+				((fa > fb) ? FLAGS_COMP_GT : 0);
+		default :
+			memcpy(&da, pa, sz);
+			memcpy(&db, pb, sz);
+			return (da < db) ? FLAGS_COMP_LT :
+				((da > db) ? FLAGS_COMP_GT : 0);
 	}
-	return ret;
+}
+
+int in_cmp(vm_t *vm_status, uint8_t UNUSED(opcode), uint8_t arg)
+{
+	int res;
+
+	/* discard previous comparison results */
+	vm_status->flags = (vm_status->flags >> 2) << 2;
+
+	res = cmp_pop(vm_status, arg);
+	if (res < 0)
+		return 1;
+	vm_status->flags |= res;
+	return 0;
 }
 
 int in_if(vm_t *vm_status, uint8_t opcode, uint8_t UNUSED(arg))
 {
+	const uint8_t *code;
 	uint8_t skip = 1;
 	
 	switch (opcode) {
@@ -1082,12 +1535,64 @@ int in_if(vm_t *vm_status, uint8_t opcode, uint8_t UNUSED(arg))
 			else if (!(vm_status->flags & FLAGS_COMP_GT))
 				skip = 0;
 			break;
+		case IN_IFOV :
+			if (vm_status->flags & FLAGS_OVF)
+				skip = 0;
+			break;
+		case IN_IFNOV :
+			if (!(vm_status->flags & FLAGS_OVF))
+				skip = 0;
+			break;
 		default : return 1;
 	}
 
-	/* If skip != 0, move nip to new position (+2) */
-	if (skip)
-		vm_status->nip.addr += 2;
+	/* If skip != 0, move nip past next instruction */
+	if (skip) {
+		code = vm_status->ctbl[vm_status->nip.obj].data;
+		if (vm_status->nip.addr + 1
+			>= vm_status->ctbl[vm_status->nip.obj].sz)
+			return 1;
+		vm_status->nip.addr += in_length(code[vm_status->nip.addr],
+				code[vm_status->nip.addr + 1]);
+	}
+
+	return 0;
+}
 
+/* Fused compare and branch */
+int in_br(vm_t *vm_status, uint8_t opcode, uint8_t arg)
+{
+	const uint8_t *code;
+	int32_t offset;
+	int res, take;
+
+	/* Flags are set as by CMP */
+	vm_status->flags = (vm_status->flags >> 2) << 2;
+	res = cmp_pop(vm_status, arg);
+	if (res < 0)
+		return 1;
+	vm_status->flags |= res;
+
+	switch (opcode) {
+		case IN_BEQ : take = (res == 0); break;
+		case IN_BNE : take = (res != 0); break;
+		case IN_BGT : take = (res == FLAGS_COMP_GT); break;
+		case IN_BGE : take = (res != FLAGS_COMP_LT); break;
+		case IN_BLT : take = (res == FLAGS_COMP_LT); break;
+		case IN_BLE : take = (res != FLAGS_COMP_GT); break;
+		default : return 1;
+	}
+
+	code = &vm_status->ctbl[vm_status->cip.obj]
+		.data[vm_status->cip.addr + 2];
+	vm_status->nip.addr += sizeof(int32_t);
+	if (!take)
+		return 0;
+
+	memcpy(&offset, code, sizeof(int32_t));
+	vm_status->nip.addr += (int32_t)ntohl(offset);
+	if (!obj_target(&vm_status->ctbl[vm_status->nip.obj],
+				vm_status->nip.addr))
+		return 1;
 	return 0;
 }
@@ -43,11 +43,16 @@
  *
  * STDCALL_FLAGS specify how standard function call will be performed,
  * they are not used yet.
+ *
+ * SNAPSHOT saves whole VM to snapshot file and ends execution with
+ * SNAP_EXIT as exit code, when VM was started with one (auvm -S); it does
+ * nothing otherwise. Restored VM continues after SNAPSHOT.
  */
 #define IN_NOP		0x00 /* No operation (no arg) */
 #define IN_END		0x01 /* End execution (no arg) */
 #define IN_DEBUG	0x02 /* Toggle debugging (DBG_FLAGS) */
 #define IN_STDCALL	0x03 /* Standard Function Call (STDCALL_FLAGS) */
+#define IN_SNAPSHOT	0x04 /* Save VM snapshot (SNAP_EXIT) */
 
 /* Stack instructions
  *
@@ -65,6 +70,45 @@
 #define IN_GET		0x12 /* Duplicate X element on stack (GET_POSSZ) */
 #define IN_DROP		0x13 /* Drop head from stack (DROP_SZ) */
 
+/* Frame instructions
+ *
+ * FRAME_OFF is signed 8-bit offset in bytes from frame pointer (FP). CALL
+ * with CALL_FRAME flag sets FP to top of the stack after popping call target,
+ * so arguments pushed by caller are at negative offsets and callee's locals
+ * (pushed after the call) at offsets >= 0. RET restores caller's FP.
+ *
+ * LDL_* push copy of local of given width, STL_* pop value of given width
+ * and store it to local.
+ */
+#define IN_LDL_1	0x14 /* Load 1-byte local (FRAME_OFF) */
+#define IN_LDL_2	0x15 /* Load 2-byte local (FRAME_OFF) */
+#define IN_LDL_4	0x16 /* Load 4-byte local (FRAME_OFF) */
+#define IN_LDL_8	0x17 /* Load 8-byte local (FRAME_OFF) */
+#define IN_STL_1	0x18 /* Store 1-byte local (FRAME_OFF) */
+#define IN_STL_2	0x19 /* Store 2-byte local (FRAME_OFF) */
+#define IN_STL_4	0x1A /* Store 4-byte local (FRAME_OFF) */
+#define IN_STL_8	0x1B /* Store 8-byte local (FRAME_OFF) */
+
+/* Bulk instructions
+ *
+ * Operate on regions of data stack given by absolute position and length,
+ * all of them 32-bit unsigned integers popped in order listed below (so
+ * length is pushed last). Regions must lie within the stack.
+ *
+ *  - BCOPY: length, source, destination; regions may overlap
+ *  - BFILL: length, value (1 byte), position
+ *  - BCMP: length, first position, second position; sets flags like CMP
+ *  - BREV: length, position; reverses bytes in place
+ *
+ * With BULK_TOP flag, BCOPY and BFILL don't pop destination and push the
+ * result on top of the stack instead, BREV doesn't pop position and
+ * reverses [length] bytes on top of the stack.
+ */
+#define IN_BCOPY	0x1C /* Copy block (BULK_FLAGS) */
+#define IN_BFILL	0x1D /* Fill block with byte (BULK_FLAGS) */
+#define IN_BCMP		0x1E /* Compare 2 blocks (BULK_FLAGS) */
+#define IN_BREV		0x1F /* Reverse block (BULK_FLAGS) */
+
 /* Arithmetical and Logical
  * 
  * UI - unsigned integer
@@ -73,16 +117,20 @@
  * SF - signed float
  *
  * {ADD,SUB,MUL,DIV,MOD}_SZ determine how many bytes wide are both arguments,
- * allowed values are: 1, 2, 4, 8 ... depending on functionality of VM
+ * allowed values are: 1, 2, 4, 8 and 16 where compiler supports 128-bit
+ * integers (INT_SZ_MAX). Integer arithmetic wraps around, division by zero
+ * is an error.
  *
  * {ADD,SUB,MUL,DIV}_TYPE determine type of FP arguments available (and thus,
  * their size (float, double ...)
  *
  * {AND,OR,XOR,NOT,SHL,SHR,ROTL,ROTR}_SZ specify width of argument(s) to be
- * used in these functions. Shift and rotate instructions also have 1-byte
- * wide argument preceeding the actual number. This argument specifies shift
- * or rotation space (how many bits to the right/left should the value be
- * shifted/rotated). This allows for maximum of 255-bit shift/rotation.
+ * used in these functions (same sizes as above, 0 is taken as 1). Logical
+ * variants result in 0 or 1 of the same width. Shift and rotate instructions
+ * also have 1-byte wide argument preceeding the actual number. This argument
+ * specifies shift or rotation space (how many bits to the right/left should
+ * the value be shifted/rotated). This allows for maximum of 255-bit
+ * shift/rotation, shifting by at least width of the value gives 0.
  */
 #define IN_ADD_UI	0x20 /* Add 2 unsigned integers (ADD_SZ) */
 #define IN_ADD_SI	0x21 /* Add 2 signed integers (ADD_SZ) */
@@ -127,7 +175,29 @@
  * will change (+/-)) or absolute (32-bit unsigned integer, address in current
  * object).
  *
- * {CALL,JMP}_FLAGS are currently unused
+ * CALL_TYPE may be combined with CALL_FRAME flag, which makes the call
+ * establish new frame (see Frame instructions). CALL_L_FLAGS accept
+ * CALL_FRAME too.
+ *
+ * JMP_FLAGS are currently unused
+ *
+ * Direct long jumps / calls are long ones with target following the
+ * instruction (object and address, both 32-bit big endian, and 4 reserved
+ * bytes) instead of taken from stack. tools/objlink rewrites long jumps
+ * with static targets (LOAD 4 obj; LOAD 4 addr; JMP_L) into them, both
+ * are 14 bytes long.
+ *
+ * SWITCH_COUNT is number of entries in table following the instruction,
+ * 0 means 256. Table starts with default entry, which is used for index
+ * out of range, and contains 32-bit big endian offsets relative to its end.
+ *
+ * LOOP and NEXT run counted loops on loop counter registers (LOOP_REG is
+ * register number, below LOOP_REGS). Both are followed by 32-bit big endian
+ * offset relative to end of instruction. LOOP pops 32-bit unsigned count to
+ * the register and jumps to the offset (past the loop) if it is 0, NEXT
+ * decrements the register and jumps to the offset (loop body) unless it
+ * reached 0. Registers are saved by CALL and restored by RET, so every
+ * function has its own set.
  *
  * RET_COUNT specifies, how many levels should return ... return, this can be
  * used for quick return to top directory, effectively solving exceptions in
@@ -136,15 +206,27 @@
 #define IN_JMP		0x40 /* Object-wise jump (JMP_TYPE: REL | ABS) */
 #define IN_JMP_L	0x41 /* Long jump (JMP_FLAGS) */
 #define IN_CALL		0x42 /* Object-wise returnable jump (CALL_TYPE) */
-#define IN_CALL_L	0x43 /* Long returnable jump (CALL_FLAGS) */
+#define IN_CALL_L	0x43 /* Long returnable jump (CALL_L_FLAGS) */
 #define IN_RET		0x44 /* Return (RET_COUNT) */
+#define IN_SWITCH	0x45 /* Indexed jump (SWITCH_COUNT) */
+#define IN_LOOP		0x46 /* Start counted loop (LOOP_REG) */
+#define IN_NEXT		0x47 /* Next iteration of counted loop (LOOP_REG) */
+#define IN_JMP_D	0x48 /* Direct long jump (JMP_FLAGS) */
+#define IN_CALL_D	0x49 /* Direct long returnable jump (CALL_L_FLAGS) */
 
 /* Conditionals
  * 
- * IN_IF* instructions don't use arguments
+ * IN_IF* instructions don't use arguments, they skip whole next instruction
+ * (including LOAD data).
  *
  * CMP_FLAGS contain information about size of arguments in bytes and type:
- *  -> INT vs. FP
+ *  -> INT vs. FP (AUVMF_*) in low 4 bits
+ *  -> log2 of size of INT arguments (1, 2, 4, 8 or 16 bytes) in bits 4-6
+ *
+ * IN_IFOV and IN_IFNOV test FLAGS_OVF set by overflow checking arithmetic.
+ *
+ * IN_B* compare like IN_CMP and branch if condition holds; 32-bit big endian
+ * offset relative to end of instruction follows them.
  */
 #define IN_CMP		0x50 /* Compare 2 arguments (CMP_FLAGS) */
 #define IN_IFEQ		0x51 /* Execute next IN if last CMP was equal */
@@ -153,5 +235,180 @@
 #define IN_IFGE		0x54 /* ... if first arg >= second in last CMP */
 #define IN_IFLT		0x55 /* ... if first arg < second in last CMP */
 #define IN_IFLE		0x56 /* ... if first arg <= second in last CMP */
+#define IN_BEQ		0x57 /* Compare (CMP_FLAGS), branch if equal */
+#define IN_BNE		0x58 /* ... branch if NOT equal */
+#define IN_BGT		0x59 /* ... branch if first argument > second */
+#define IN_BGE		0x5A /* ... branch if first arg >= second */
+#define IN_BLT		0x5B /* ... branch if first arg < second */
+#define IN_BLE		0x5C /* ... branch if first arg <= second */
+#define IN_IFOV		0x5D /* Execute next IN if last *O overflowed */
+#define IN_IFNOV	0x5E /* ... if last *O did NOT overflow */
+
+/* Vector instructions
+ *
+ * VEC_FLAGS contain lane type (VEC_U8, VEC_U16, VEC_U32, VEC_F32, VEC_F64)
+ * and vector width (VEC_128 or VEC_256, that is 16 or 32 bytes).
+ *
+ * Element-wise instructions pop 2 vectors (first one is head of the stack)
+ * and push result of (first op second) for each lane. Integer lanes are
+ * unsigned, arithmetic wraps around. VCMP* set all bits of lane when
+ * comparison is true and clear them otherwise.
+ *
+ * Horizontal instructions (VSUM, VHMIN, VHMAX) pop one vector and push
+ * single lane-sized result.
+ */
+#define IN_VADD		0x60 /* Add vectors (VEC_FLAGS) */
+#define IN_VSUB		0x61 /* Subtract vectors (VEC_FLAGS) */
+#define IN_VMUL		0x62 /* Multiply vectors (VEC_FLAGS) */
+#define IN_VMIN		0x63 /* Lane-wise minimum (VEC_FLAGS) */
+#define IN_VMAX		0x64 /* Lane-wise maximum (VEC_FLAGS) */
+#define IN_VCMPEQ	0x65 /* Lane-wise equality mask (VEC_FLAGS) */
+#define IN_VCMPGT	0x66 /* Lane-wise greater-than mask (VEC_FLAGS) */
+#define IN_VSUM		0x67 /* Sum of all lanes (VEC_FLAGS) */
+#define IN_VHMIN	0x68 /* Minimum of all lanes (VEC_FLAGS) */
+#define IN_VHMAX	0x69 /* Maximum of all lanes (VEC_FLAGS) */
+
+/* Floating point kernels
+ *
+ * RED_FLAGS contain element type (VEC_F32 or VEC_F64) and flags RED_MEM
+ * and RED_ORD, FMA takes element type only.
+ *
+ * FMA pops 3 values and pushes (first * second + third) rounded once.
+ *
+ * FDOT, FSUM, FMIN and FMAX pop 32-bit element count N and reduce N
+ * elements to single one, which is pushed. Elements lie on the stack
+ * below N and are popped too (FDOT pops 2 such blocks, elements of first
+ * one are multiplied by those at the same offset in second one). With
+ * RED_MEM they are in linear memory instead, at 32-bit addresses popped
+ * after N (first block first).
+ *
+ * Reductions are vectorized, so order of operations (and rounding of the
+ * result) depends on CPU; RED_ORD makes them go in order of addresses, so
+ * the result is the same everywhere. Empty FSUM and FDOT give 0, FMIN +inf
+ * and FMAX -inf; FMIN and FMAX ignore NaN elements.
+ */
+#define IN_FMA		0x6A /* Fused multiply-add (RED_FLAGS) */
+#define IN_FDOT		0x6B /* Dot product (RED_FLAGS) */
+#define IN_FSUM		0x6C /* Sum (RED_FLAGS) */
+#define IN_FMIN		0x6D /* Minimum (RED_FLAGS) */
+#define IN_FMAX		0x6E /* Maximum (RED_FLAGS) */
+
+/* Linear memory instructions
+ *
+ * Addresses are 32-bit unsigned integers popped from stack, values are
+ * copied between memory and stack as they are (in host byte order).
+ *
+ * MEM_SZ specifies width of value in bytes (1, 2, 4, 8 ...).
+ *
+ * MGROW pops 32-bit number of bytes to add to memory (rounded up to whole
+ * pages) and pushes previous size of memory, or 0xffffffff when memory
+ * can't grow (limit is set on VM initialization).
+ */
+#define IN_MLOAD	0x80 /* Load value from address (MEM_SZ) */
+#define IN_MSTORE	0x81 /* Store value to address (MEM_SZ) */
+#define IN_MSIZE	0x82 /* Push current memory size (no arg) */
+#define IN_MGROW	0x83 /* Grow memory (no arg) */
+
+/* Immediate forms
+ *
+ * Short forms of common instructions, whose constant operand is part of
+ * instruction instead of being LOADed first. IMM8 is the argument taken as
+ * signed 8-bit integer, IMM32 is 32-bit big endian integer following the
+ * instruction.
+ *
+ * ADDI adds IMM8 to integer of given size on top of the stack in place,
+ * PUSHI pushes IMM8 extended to given size. JMPI jumps IMM8 bytes relative
+ * to the end of instruction, JMPW and CALLW (CALL_TYPE flags, relative
+ * only) by IMM32. GETI is GET of GET_SZ bytes from position IMM32.
+ */
+#define IN_ADDI_1	0x90 /* Add to 1-byte integer (IMM8) */
+#define IN_ADDI_2	0x91 /* Add to 2-byte integer (IMM8) */
+#define IN_ADDI_4	0x92 /* Add to 4-byte integer (IMM8) */
+#define IN_ADDI_8	0x93 /* Add to 8-byte integer (IMM8) */
+#define IN_PUSHI_1	0x94 /* Push 1-byte integer (IMM8) */
+#define IN_PUSHI_2	0x95 /* Push 2-byte integer (IMM8) */
+#define IN_PUSHI_4	0x96 /* Push 4-byte integer (IMM8) */
+#define IN_PUSHI_8	0x97 /* Push 8-byte integer (IMM8) */
+#define IN_JMPI		0x98 /* Short relative jump (IMM8) */
+#define IN_JMPW		0x99 /* Relative jump (no arg), IMM32 follows */
+#define IN_CALLW	0x9A /* Relative call (CALL_TYPE), IMM32 follows */
+#define IN_GETI		0x9B /* Get element (GET_SZ), IMM32 follows */
+
+/* Register machine
+ *
+ * Every call depth has its own file of REG_COUNT 8-byte registers, CALL
+ * switches to new zeroed one and RET back to caller's. Value of register
+ * is kept in host order in its first bytes, its type is given by
+ * instruction using it.
+ *
+ * Three-address instructions are followed by register numbers D, A and B
+ * (1 byte each) and compute D = A op B. REG_FLAGS have the same format as
+ * CMP_FLAGS (integers up to 8 bytes); integer arithmetic wraps around and
+ * division by zero is an error. MOD, AND, OR, XOR, SHL and SHR are integer
+ * only, SHR of signed integer is arithmetic.
+ *
+ * RMOV is followed by D and A, RCMP by A and B and sets FLAGS as CMP of A
+ * (first) and B. RLDI loads 64-bit big endian immediate following it to
+ * register REG. RPUSH and RPOP move REG_SZ bytes between register (given by
+ * following byte) and stack, RPOP clears rest of the register.
+ *
+ * RSTDCALL calls function STDCALL_ID (see IN_STDCALL) taking its argument
+ * N from register R + N, R follows instruction. Bytes arguments are still
+ * popped from stack.
+ */
+#define IN_RADD		0xB0 /* D = A + B (REG_FLAGS) */
+#define IN_RSUB		0xB1 /* D = A - B (REG_FLAGS) */
+#define IN_RMUL		0xB2 /* D = A * B (REG_FLAGS) */
+#define IN_RDIV		0xB3 /* D = A / B (REG_FLAGS) */
+#define IN_RMOD		0xB4 /* D = A % B (REG_FLAGS) */
+#define IN_RAND		0xB5 /* D = A & B (REG_FLAGS) */
+#define IN_ROR		0xB6 /* D = A | B (REG_FLAGS) */
+#define IN_RXOR		0xB7 /* D = A ^ B (REG_FLAGS) */
+#define IN_RSHL		0xB8 /* D = A << B (REG_FLAGS) */
+#define IN_RSHR		0xB9 /* D = A >> B (REG_FLAGS) */
+#define IN_RMOV		0xBA /* D = A (no arg) */
+#define IN_RCMP		0xBB /* Compare A and B (REG_FLAGS) */
+#define IN_RLDI		0xBC /* Load immediate (REG), IMM64 follows */
+#define IN_RPUSH	0xBD /* Push register (REG_SZ) */
+#define IN_RPOP		0xBE /* Pop to register (REG_SZ) */
+#define IN_RSTDCALL	0xBF /* Call function (STDCALL_ID), R follows */
+
+/* Overflow checking and widening arithmetic
+ *
+ * *O instructions compute like their plain counterparts and set FLAGS_OVF
+ * when the exact result doesn't fit into their size (which is then
+ * truncated as usual), clear it otherwise.
+ *
+ * MULW pops 2 integers of MULW_SZ bytes and pushes their full product of
+ * 2 * MULW_SZ bytes.
+ */
+#define IN_ADDO_UI	0xC0 /* Add unsigned, check overflow (ADD_SZ) */
+#define IN_ADDO_SI	0xC1 /* Add signed, check overflow (ADD_SZ) */
+#define IN_SUBO_UI	0xC2 /* Subtract unsigned, check overflow (SUB_SZ) */
+#define IN_SUBO_SI	0xC3 /* Subtract signed, check overflow (SUB_SZ) */
+#define IN_MULO_UI	0xC4 /* Multiply unsigned, check overflow (MUL_SZ) */
+#define IN_MULO_SI	0xC5 /* Multiply signed, check overflow (MUL_SZ) */
+#define IN_MULW_UI	0xC6 /* Widening unsigned multiply (MULW_SZ) */
+#define IN_MULW_SI	0xC7 /* Widening signed multiply (MULW_SZ) */
+
+/* Conversions
+ *
+ * CVT pops value described by its argument (CVT_FLAGS, same format as
+ * CMP_FLAGS) and pushes it converted to type given by CVT_FLAGS in byte
+ * following the instruction. Destination flags with CVT_SAT set saturate:
+ * integers are clamped to range of destination, NaN becomes 0 and finite
+ * doubles too large for float become largest float.
+ *
+ * Without CVT_SAT integers are truncated to destination size and floating
+ * point value not fitting into destination integer is an error.
+ *
+ * Floating point source is rounded to integral value towards zero (CVT,
+ * integer destination only), to nearest even (CVT_RN), down (CVT_RD) or
+ * up (CVT_RU), even if destination is floating point too.
+ */
+#define IN_CVT		0xC8 /* Convert (CVT_FLAGS), destination follows */
+#define IN_CVT_RN	0xC9 /* Convert, round to nearest (CVT_FLAGS) */
+#define IN_CVT_RD	0xCA /* Convert, round down (CVT_FLAGS) */
+#define IN_CVT_RU	0xCB /* Convert, round up (CVT_FLAGS) */
 
 #endif /* _INS_H_ */
@@ -64,6 +64,7 @@ in_t *in_table_init(void)
 	ret[IN_END] = &in_end;
 	ret[IN_DEBUG] = &in_debug;
 	ret[IN_STDCALL] = &in_stdcall;
+	ret[IN_SNAPSHOT] = &in_snapshot;
 
 	ret[IN_LOAD] = NULL; /* special case handled by parse function */
 
@@ -72,6 +73,22 @@ in_t *in_table_init(void)
 	ret[IN_GET] = &in_stack;
 	ret[IN_DROP] = &in_stack;
 
+	/* frame */
+	ret[IN_LDL_1] = &in_frame;
+	ret[IN_LDL_2] = &in_frame;
+	ret[IN_LDL_4] = &in_frame;
+	ret[IN_LDL_8] = &in_frame;
+	ret[IN_STL_1] = &in_frame;
+	ret[IN_STL_2] = &in_frame;
+	ret[IN_STL_4] = &in_frame;
+	ret[IN_STL_8] = &in_frame;
+
+	/* bulk */
+	ret[IN_BCOPY] = &in_bulk;
+	ret[IN_BFILL] = &in_bulk;
+	ret[IN_BCMP] = &in_bulk;
+	ret[IN_BREV] = &in_bulk;
+
 	/* arithmetical and logical */
 	ret[IN_ADD_UI] = &in_add;
 	ret[IN_ADD_SI] = &in_add;
@@ -120,6 +137,11 @@ in_t *in_table_init(void)
 	ret[IN_CALL] = &in_jmp;
 	ret[IN_CALL_L] = &in_jmp;
 	ret[IN_RET] = &in_ret;
+	ret[IN_SWITCH] = &in_switch;
+	ret[IN_LOOP] = &in_loop;
+	ret[IN_NEXT] = &in_loop;
+	ret[IN_JMP_D] = &in_jmp;
+	ret[IN_CALL_D] = &in_jmp;
 
 	/* conditionals */
 	ret[IN_CMP] = &in_cmp;
@@ -129,6 +151,53 @@ in_t *in_table_init(void)
 	ret[IN_IFGE] = &in_if;
 	ret[IN_IFLT] = &in_if;
 	ret[IN_IFLE] = &in_if;
+	ret[IN_BEQ] = &in_br;
+	ret[IN_BNE] = &in_br;
+	ret[IN_BGT] = &in_br;
+	ret[IN_BGE] = &in_br;
+	ret[IN_BLT] = &in_br;
+	ret[IN_BLE] = &in_br;
+	ret[IN_IFOV] = &in_if;
+	ret[IN_IFNOV] = &in_if;
+
+	/* linear memory */
+	ret[IN_MLOAD] = &in_mem;
+	ret[IN_MSTORE] = &in_mem;
+	ret[IN_MSIZE] = &in_mem;
+	ret[IN_MGROW] = &in_mem;
+
+	/* immediate forms */
+	ret[IN_ADDI_1] = &in_imm;
+	ret[IN_ADDI_2] = &in_imm;
+	ret[IN_ADDI_4] = &in_imm;
+	ret[IN_ADDI_8] = &in_imm;
+	ret[IN_PUSHI_1] = &in_imm;
+	ret[IN_PUSHI_2] = &in_imm;
+	ret[IN_PUSHI_4] = &in_imm;
+	ret[IN_PUSHI_8] = &in_imm;
+	ret[IN_JMPI] = &in_jmp;
+	ret[IN_JMPW] = &in_jmp;
+	ret[IN_CALLW] = &in_jmp;
+	ret[IN_GETI] = &in_imm;
+
+	/* overflow checking and widening arithmetic */
+	for (i = IN_ADDO_UI; i <= IN_MULW_SI; i++)
+		ret[i] = &in_wide;
+
+	/* conversions */
+	for (i = IN_CVT; i <= IN_CVT_RU; i++)
+		ret[i] = &in_cvt;
+
+	/* register machine */
+	for (i = IN_RADD; i <= IN_RSTDCALL; i++)
+		ret[i] = &in_reg;
+
+	/* vectors */
+	vec_init();
+	for (i = IN_VADD; i <= IN_VHMAX; i++)
+		ret[i] = &in_vec;
+	for (i = IN_FMA; i <= IN_FMAX; i++)
+		ret[i] = &in_red;
 
 	return ret;
 }
@@ -0,0 +1,46 @@
+#ifndef _LIB_FUNCS_H_
+#define _LIB_FUNCS_H_
+
+/*
+ * lib/funcs.h - AUVM Library function list
+ *
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * FUNC(id, name, wrapper, arity, signature) for every function of AUVM
+ * Library; stdcall IDs are fixed and must stay below FUNC_MODULE_BASE.
+ */
+#define AUVMLIB_FUNCS \
+	FUNC(1, "print_str", wrapper_print_str, 3, "i4 u4 b") \
+	FUNC(2, "print_int", wrapper_print_int, 2, "i4 i4") \
+	FUNC(3, "print_uint", wrapper_print_uint, 2, "i4 u4") \
+	FUNC(4, "print_float", wrapper_print_float, 3, "i4 i1 f4") \
+	FUNC(5, "print_double", wrapper_print_double, 3, "i4 i1 f8") \
+	FUNC(6, "arena_alloc", wrapper_arena_alloc, 1, "u4") \
+	FUNC(7, "arena_mark", wrapper_arena_mark, 0, "") \
+	FUNC(8, "arena_release", wrapper_arena_release, 1, "u4") \
+	FUNC(9, "arena_reset", wrapper_arena_reset, 0, "") \
+	FUNC(10, "pool_alloc", wrapper_pool_alloc, 1, "u4") \
+	FUNC(11, "pool_free", wrapper_pool_free, 2, "u4 u4")
+
+#endif /* _LIB_FUNCS_H_ */
@@ -25,87 +25,56 @@
 #include "../auvmlib.h"
 #include "../auvm.h"
 
-#include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 
-int wrapper_print_str(vm_t *vm_status)
+int wrapper_print_str(vm_t *UNUSED(vm_status), const func_arg_t *args)
 {
-	int32_t fd;
-	uint32_t str_sz;
-	char *str;
-
-	fd = *(int32_t *)ds_pop(&vm_status->ds, sizeof(int32_t));
-	str_sz = *(uint32_t *)ds_pop(&vm_status->ds, sizeof(uint32_t));
-
-	str = (char *)malloc(sizeof(char) * (str_sz + 1));
-	if (str == NULL)
-		return 1;
-	revmemcpy(str + str_sz, (const char *)ds_pop(&vm_status->ds,
-				sizeof(char) * (str_sz)), str_sz);
-
-	str[str_sz] = '\0';
-	write((int) fd, str, str_sz);
+	/* i4 fd, u4 len, b str */
+	write((int) FUNC_ARG(args, 0, int32_t), FUNC_BYTES(args, 2),
+			args[2].len);
 	return 0;
 }
 
-int wrapper_print_int(vm_t *vm_status)
+int wrapper_print_int(vm_t *UNUSED(vm_status), const func_arg_t *args)
 {
-	int32_t fd;
-	int32_t num;
+	/* i4 fd, i4 num */
 	char buf[256] = "";
 
-	fd = *(int32_t *)ds_pop(&vm_status->ds, sizeof(int32_t));
-	num = *(int32_t *)ds_pop(&vm_status->ds, sizeof(int32_t));
-
-	snprintf(buf, 255, "%d", num);
-	write((int) fd, buf, strlen(buf));
+	snprintf(buf, 255, "%d", FUNC_ARG(args, 1, int32_t));
+	write((int) FUNC_ARG(args, 0, int32_t), buf, strlen(buf));
 	return 0;
 }
 
-int wrapper_print_uint(vm_t *vm_status)
+int wrapper_print_uint(vm_t *UNUSED(vm_status), const func_arg_t *args)
 {
-	int32_t fd;
-	uint32_t num;
+	/* i4 fd, u4 num */
 	char buf[256] = "";
 
-	fd = *(int32_t *)ds_pop(&vm_status->ds, sizeof(int32_t));
-	num = *(uint32_t *)ds_pop(&vm_status->ds, sizeof(uint32_t));
-
-	snprintf(buf, 255, "%u", num);
-	write((int) fd, buf, strlen(buf));
+	snprintf(buf, 255, "%u", FUNC_ARG(args, 1, uint32_t));
+	write((int) FUNC_ARG(args, 0, int32_t), buf, strlen(buf));
 	return 0;
 }
 
-int wrapper_print_float(vm_t *vm_status)
+int wrapper_print_float(vm_t *UNUSED(vm_status), const func_arg_t *args)
 {
-	int32_t fd;
-	int8_t prec;
-	float num;
+	/* i4 fd, i1 prec, f4 num */
 	char buf[256] = "";
 
-	fd = *(int32_t *)ds_pop(&vm_status->ds, sizeof(int32_t));
-	prec = *(int8_t *)ds_pop(&vm_status->ds, sizeof(int8_t));
-	num = *(float *)ds_pop(&vm_status->ds, sizeof(float));
-
-	snprintf(buf, 255, "%.*g", (int) prec, num);
-	write((int) fd, buf, strlen(buf));
+	snprintf(buf, 255, "%.*g", (int) FUNC_ARG(args, 1, int8_t),
+			FUNC_ARG(args, 2, float));
+	write((int) FUNC_ARG(args, 0, int32_t), buf, strlen(buf));
 	return 0;
 }
 
-int wrapper_print_double(vm_t *vm_status)
+int wrapper_print_double(vm_t *UNUSED(vm_status), const func_arg_t *args)
 {
-	int32_t fd;
-	int8_t prec;
-	double num;
+	/* i4 fd, i1 prec, f8 num */
 	char buf[256] = "";
 
-	fd = *(int32_t *)ds_pop(&vm_status->ds, sizeof(int32_t));
-	prec = *(int8_t *)ds_pop(&vm_status->ds, sizeof(int8_t));
-	num = *(double *)ds_pop(&vm_status->ds, sizeof(double));
-
-	snprintf(buf, 255, "%.*g", (int) prec, num);
-	write((int) fd, buf, strlen(buf));
+	snprintf(buf, 255, "%.*g", (int) FUNC_ARG(args, 1, int8_t),
+			FUNC_ARG(args, 2, double));
+	write((int) FUNC_ARG(args, 0, int32_t), buf, strlen(buf));
 	return 0;
 }
@@ -0,0 +1,81 @@
+/*
+ * lib/mem.c - AUVM Library memory allocation functions
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "../auvmlib.h"
+#include "../auvm.h"
+
+
+/*
+ * All addresses are 32-bit, allocation functions push 0 when out of memory.
+ *
+ *  arena_alloc(size) -> addr
+ *  arena_mark() -> mark
+ *  arena_release(mark)
+ *  arena_reset()
+ *  pool_alloc(size) -> addr
+ *  pool_free(addr, size)
+ */
+
+int wrapper_arena_alloc(vm_t *vm_status, const func_arg_t *args)
+{
+	uint32_t addr;
+
+	addr = arena_alloc(&vm_status->arena, &vm_status->lm,
+			FUNC_ARG(args, 0, uint32_t));
+	return ds_pushraw(&vm_status->ds, sizeof(uint32_t), &addr);
+}
+
+int wrapper_arena_mark(vm_t *vm_status, const func_arg_t *UNUSED(args))
+{
+	uint32_t mark;
+
+	mark = arena_mark(&vm_status->arena, &vm_status->lm);
+	return ds_pushraw(&vm_status->ds, sizeof(uint32_t), &mark);
+}
+
+int wrapper_arena_release(vm_t *vm_status, const func_arg_t *args)
+{
+	return arena_release(&vm_status->arena, FUNC_ARG(args, 0, uint32_t));
+}
+
+int wrapper_arena_reset(vm_t *vm_status, const func_arg_t *UNUSED(args))
+{
+	arena_reset(&vm_status->arena);
+	return 0;
+}
+
+int wrapper_pool_alloc(vm_t *vm_status, const func_arg_t *args)
+{
+	uint32_t addr;
+
+	addr = pool_alloc(&vm_status->arena, &vm_status->lm,
+			FUNC_ARG(args, 0, uint32_t));
+	return ds_pushraw(&vm_status->ds, sizeof(uint32_t), &addr);
+}
+
+int wrapper_pool_free(vm_t *vm_status, const func_arg_t *args)
+{
+	return pool_free(&vm_status->arena, &vm_status->lm,
+			FUNC_ARG(args, 0, uint32_t), FUNC_ARG(args, 1, uint32_t));
+}
@@ -0,0 +1,559 @@
+/*
+ * mem.c - implementation of linear memory
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* memfd_create */
+#define _GNU_SOURCE
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* Local includes */
+#include "auvm.h"
+#include "mem.h"
+
+/* System includes */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define LM_ROUND(x) \
+	((((uint64_t)(x)) + LM_PAGE - 1) & ~((uint64_t)LM_PAGE - 1))
+
+/* Page entry of base file [l] at [off] */
+#define LM_ENT(l, off) (((uint64_t)(l) << 56) | (off))
+#define LM_ENT_LAYER(e) ((uint32_t)((e) >> 56))
+#define LM_ENT_OFF(e) ((e) & ((1ULL << 56) - 1))
+
+int lm_init(lm_t *m, uint32_t max)
+{
+	void *ptr;
+
+	m->lm_size = 0;
+	m->lm_max = (LM_ROUND(max) > UINT32_MAX) ?
+		(UINT32_MAX & ~(LM_PAGE - 1)) : (uint32_t)LM_ROUND(max);
+	m->lm_data = NULL;
+	m->lm_base_size = 0;
+	m->lm_layers = 0;
+	m->lm_pages = NULL;
+	if (m->lm_max == 0)
+		return 0;
+
+	/* Reserve address space only, pages are made accessible on grow */
+	ptr = mmap(NULL, m->lm_max, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (ptr == MAP_FAILED)
+		return 1;
+	m->lm_data = (uint8_t *)ptr;
+	return 0;
+}
+
+/* Forget base files, mappings of them are left alone */
+static void lm_drop_base(lm_t *m)
+{
+	uint32_t i;
+
+	for (i = 0; i < m->lm_layers; i++)
+		close(m->lm_base[i]);
+	free(m->lm_pages);
+	m->lm_pages = NULL;
+	m->lm_layers = 0;
+	m->lm_base_size = 0;
+}
+
+int lm_destroy(lm_t *m)
+{
+	int ret;
+
+	ret = m->lm_size;
+	if (m->lm_data != NULL)
+		munmap(m->lm_data, m->lm_max);
+	lm_drop_base(m);
+	m->lm_data = NULL;
+	m->lm_size = 0;
+	m->lm_max = 0;
+	return ret;
+}
+
+/* Grow memory by at least [sz] bytes (rounded up to whole pages) */
+int lm_grow(lm_t *m, uint32_t sz)
+{
+	uint64_t nsize = LM_ROUND((uint64_t)m->lm_size + sz);
+
+	if (nsize > m->lm_max)
+		return 1;
+	if (nsize == m->lm_size)
+		return 0;
+	if (mprotect(m->lm_data + m->lm_size, nsize - m->lm_size,
+				PROT_READ | PROT_WRITE) != 0)
+		return 1;
+	m->lm_size = (uint32_t)nsize;
+	return 0;
+}
+
+/* Shrink memory to zero size, discarding its pages */
+int lm_reset(lm_t *m)
+{
+	lm_drop_base(m);
+	if (m->lm_size == 0)
+		return 0;
+	/* Fresh reservation over used part also drops file mappings */
+	if (mmap(m->lm_data, m->lm_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS
+			| MAP_NORESERVE | MAP_FIXED, -1, 0) == MAP_FAILED)
+		return 1;
+	m->lm_size = 0;
+	return 0;
+}
+
+/* Replace contents of empty memory by [sz] bytes of file [fd] at [off]
+ *
+ * Pages are mapped copy-on-write, so nothing is read until touched. Both
+ * [off] and [sz] must be multiples of LM_PAGE.
+ */
+int lm_map(lm_t *m, int fd, uint64_t off, uint32_t sz)
+{
+	uint32_t i, count = sz / LM_PAGE;
+
+	if ((m->lm_size != 0) || (sz > m->lm_max) || (LM_ROUND(sz) != sz)
+		|| (off % LM_PAGE != 0))
+		return 1;
+	if (sz == 0)
+		return 0;
+	/* Keep file as base for clones, they just map it again */
+	m->lm_pages = (uint64_t *)malloc(sizeof(uint64_t) * count);
+	if (m->lm_pages == NULL)
+		return 1;
+	m->lm_base[0] = dup(fd);
+	if (m->lm_base[0] < 0) {
+		lm_drop_base(m);
+		return 1;
+	}
+	m->lm_layers = 1;
+	for (i = 0; i < count; i++)
+		m->lm_pages[i] = LM_ENT(0, off + (uint64_t)i * LM_PAGE);
+	if (mmap(m->lm_data, sz, PROT_READ | PROT_WRITE, MAP_PRIVATE
+			| MAP_FIXED, fd, (off_t)off) == MAP_FAILED) {
+		lm_drop_base(m);
+		return 1;
+	}
+	m->lm_size = sz;
+	m->lm_base_size = sz;
+	return 0;
+}
+
+/* pagemap entry bits */
+#define PM_PRESENT (1ULL << 63)
+#define PM_SWAPPED (1ULL << 62)
+#define PM_FILE (1ULL << 61)
+#define PM_BATCH 512
+
+/* Mark pages of memory written since mapping in [dirty]
+ *
+ * Written pages are private anonymous copies, pagemap tells them from
+ * untouched and read-only file pages. Without pagemap every page is
+ * considered written.
+ */
+static void lm_scan(lm_t *m, uint8_t *dirty)
+{
+	uint64_t ent[PM_BATCH];
+	uint32_t count, i, n, j;
+	int fd;
+
+	count = m->lm_size / LM_PAGE;
+	memset(dirty, 1, count);
+	if (sysconf(_SC_PAGESIZE) != LM_PAGE)
+		return;
+	fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	for (i = 0; i < count; i += n) {
+		n = (count - i > PM_BATCH) ? PM_BATCH : count - i;
+		if (pread(fd, ent, n * sizeof(uint64_t),
+			(off_t)(((uintptr_t)m->lm_data / LM_PAGE + i)
+				* sizeof(uint64_t)))
+				!= (ssize_t)(n * sizeof(uint64_t)))
+			break;
+		for (j = 0; j < n; j++)
+			dirty[i + j] = (ent[j] & (PM_PRESENT | PM_SWAPPED))
+				&& !(ent[j] & PM_FILE);
+	}
+	close(fd);
+}
+
+/* Map pages [first, first + n) of memory as their entries say */
+static int lm_remap(lm_t *m, uint32_t first, uint32_t n)
+{
+	uint64_t e = m->lm_pages[first];
+
+	if (e == LM_ANON)
+		return mprotect(m->lm_data + (uint64_t)first * LM_PAGE,
+			(uint64_t)n * LM_PAGE, PROT_READ | PROT_WRITE) != 0;
+	return mmap(m->lm_data + (uint64_t)first * LM_PAGE,
+		(uint64_t)n * LM_PAGE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_FIXED, m->lm_base[LM_ENT_LAYER(e)],
+		(off_t)LM_ENT_OFF(e)) == MAP_FAILED;
+}
+
+/* Length of run of pages from [first] backed contiguously by one file */
+static uint32_t lm_run(lm_t *m, uint32_t first, uint32_t count)
+{
+	uint64_t e = m->lm_pages[first];
+	uint32_t n;
+
+	for (n = 1; first + n < count; n++) {
+		if (e == LM_ANON) {
+			if (m->lm_pages[first + n] != LM_ANON)
+				break;
+		} else if (m->lm_pages[first + n]
+				!= e + (uint64_t)n * LM_PAGE)
+			break;
+	}
+	return n;
+}
+
+/* Move pages written since last freeze into new base file
+ *
+ * Only written pages are copied, the rest keep their base files. When
+ * more than half of the pages are written or no base file is left, all
+ * pages are moved into a single new one instead.
+ */
+static int lm_freeze(lm_t *m)
+{
+	uint32_t count, used, ndirty, i, n, l;
+	uint64_t *pages;
+	uint8_t *dirty;
+	ssize_t r;
+	size_t done;
+	int fd, all;
+
+	count = m->lm_size / LM_PAGE;
+	pages = (uint64_t *)realloc(m->lm_pages, sizeof(uint64_t) * count);
+	if (pages == NULL)
+		return 1;
+	for (i = m->lm_base_size / LM_PAGE; i < count; i++)
+		pages[i] = LM_ANON;
+	m->lm_pages = pages;
+	m->lm_base_size = m->lm_size;
+
+	dirty = (uint8_t *)malloc(count);
+	if (dirty == NULL)
+		return 1;
+	lm_scan(m, dirty);
+	for (i = used = ndirty = 0; i < count; i++) {
+		used += (pages[i] != LM_ANON) || dirty[i];
+		ndirty += dirty[i];
+	}
+	if (ndirty == 0) {
+		free(dirty);
+		return 0;
+	}
+	all = (m->lm_layers == LM_LAYERS) || (ndirty * 2 > used);
+	if (all) {
+		for (i = 0; i < count; i++)
+			dirty[i] |= (pages[i] != LM_ANON);
+		ndirty = used;
+	}
+
+	fd = memfd_create("auvm-lm", MFD_CLOEXEC);
+	if (fd < 0)
+		goto fail;
+	if (ftruncate(fd, (off_t)ndirty * LM_PAGE) != 0)
+		goto fail;
+	for (i = 0, n = 0; i < count; i++) {
+		if (!dirty[i])
+			continue;
+		for (done = 0; done < LM_PAGE; done += r) {
+			r = pwrite(fd, m->lm_data + (uint64_t)i * LM_PAGE
+				+ done, LM_PAGE - done,
+				(off_t)n * LM_PAGE + done);
+			if (r <= 0)
+				goto fail;
+		}
+		n++;
+	}
+
+	/* File holds everything now, switch pages over to it */
+	if (all) {
+		for (l = 0; l < m->lm_layers; l++)
+			close(m->lm_base[l]);
+		m->lm_layers = 0;
+	}
+	l = m->lm_layers++;
+	m->lm_base[l] = fd;
+	for (i = 0, n = 0; i < count; i++)
+		if (dirty[i])
+			pages[i] = LM_ENT(l, (uint64_t)n++ * LM_PAGE);
+	for (i = 0; i < count; i += n) {
+		for (n = 1; (i + n < count) && (dirty[i + n] == dirty[i]);
+				n++);
+		if (dirty[i] && (lm_remap(m, i, n) != 0)) {
+			free(dirty);
+			return 1;
+		}
+	}
+	free(dirty);
+	return 0;
+fail:
+	if (fd >= 0)
+		close(fd);
+	free(dirty);
+	return 1;
+}
+
+/* Make empty memory [dst] a copy-on-write copy of [src]
+ *
+ * Pages of [src] written since its last freeze are moved into a new base
+ * file first (single copy). Both then map the base files privately, pages
+ * are copied only when either side writes them.
+ */
+int lm_clone(lm_t *dst, lm_t *src)
+{
+	uint32_t count, i, n;
+
+	if ((dst->lm_size != 0) || (dst->lm_max < src->lm_size))
+		return 1;
+	if (src->lm_size == 0)
+		return 0;
+	if (lm_freeze(src) != 0)
+		return 1;
+
+	lm_drop_base(dst);
+	count = src->lm_size / LM_PAGE;
+	dst->lm_pages = (uint64_t *)malloc(sizeof(uint64_t) * count);
+	if (dst->lm_pages == NULL)
+		return 1;
+	memcpy(dst->lm_pages, src->lm_pages, sizeof(uint64_t) * count);
+	for (i = 0; i < src->lm_layers; i++) {
+		dst->lm_base[i] = dup(src->lm_base[i]);
+		if (dst->lm_base[i] < 0) {
+			lm_drop_base(dst);
+			return 1;
+		}
+		dst->lm_layers++;
+	}
+	dst->lm_base_size = src->lm_size;
+	/* Size first, so that lm_reset drops partial mappings on failure */
+	dst->lm_size = src->lm_size;
+	for (i = 0; i < count; i += n) {
+		n = lm_run(dst, i, count);
+		if (lm_remap(dst, i, n) != 0) {
+			lm_reset(dst);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void *lm_getelem(lm_t *m, uint32_t addr, uint32_t sz)
+{
+	if ((uint64_t)addr + sz <= m->lm_size)
+		return &(m->lm_data[addr]);
+	else return NULL;
+}
+
+uint32_t lm_size(lm_t *m)
+{
+	return m->lm_size;
+}
+
+uint32_t lm_limit(lm_t *m)
+{
+	return m->lm_max;
+}
+
+
+/* Arena */
+
+#define ARENA_ROUND(x) \
+	((((uint64_t)(x)) + ARENA_ALIGN - 1) & ~((uint64_t)ARENA_ALIGN - 1))
+
+void arena_init(arena_t *a)
+{
+	a->base = 0;
+	a->top = 0;
+	a->floor = 0;
+	a->end = 0;
+	memset(a->pool, 0, sizeof(a->pool));
+}
+
+/* Drop everything allocated, O(1) */
+void arena_reset(arena_t *a)
+{
+	a->top = a->floor;
+	memset(a->pool, 0, sizeof(a->pool));
+}
+
+/* Set base on first use, keeping address 0 unallocated. Memory grown
+ * since by MGROW belongs to program, so allocation and later resets
+ * continue above it. */
+static void arena_start(arena_t *a, lm_t *m)
+{
+	if (a->base == 0) {
+		a->base = (uint32_t)ARENA_ROUND(m->lm_size ? m->lm_size : 1);
+		a->top = a->base;
+		a->floor = a->base;
+		a->end = m->lm_size;
+	}
+	if (m->lm_size > a->end) {
+		if (m->lm_size > a->top)
+			a->top = m->lm_size;
+		a->floor = a->top;
+		a->end = m->lm_size;
+	}
+}
+
+uint32_t arena_alloc(arena_t *a, lm_t *m, uint32_t sz)
+{
+	uint64_t addr, end;
+
+	arena_start(a, m);
+	addr = ARENA_ROUND(a->top);
+	end = addr + sz;
+	if ((end > m->lm_size) && ((end > UINT32_MAX)
+		|| (lm_grow(m, (uint32_t)(end - m->lm_size)) != 0)))
+		return 0;
+	a->top = (uint32_t)end;
+	a->end = m->lm_size;
+	return (uint32_t)addr;
+}
+
+uint32_t arena_mark(arena_t *a, lm_t *m)
+{
+	arena_start(a, m);
+	return a->top;
+}
+
+/* Free everything allocated after mark; pooled blocks are forgotten */
+int arena_release(arena_t *a, uint32_t mark)
+{
+	if ((mark < a->base) || (mark > a->top))
+		return 1;
+	a->top = (mark > a->floor) ? mark : a->floor;
+	memset(a->pool, 0, sizeof(a->pool));
+	return 0;
+}
+
+/* Pool block header: POOL_TAG | class, POOL_FREE set while in free list */
+#define POOL_TAG 0x504f4f00
+#define POOL_FREE 0x80
+
+/* Header of pool block at [addr], NULL if it can't be one */
+static uint8_t *pool_hdr(arena_t *a, lm_t *m, uint32_t addr)
+{
+	if ((addr < a->base + ARENA_HDR) || (addr >= a->top))
+		return NULL;
+	return lm_getelem(m, addr - ARENA_HDR, ARENA_HDR);
+}
+
+/* Size class for [sz] bytes, ARENA_POOLS if too big */
+static int pool_class(uint32_t sz)
+{
+	int i;
+
+	for (i = 0; i < ARENA_POOLS; i++)
+		if (sz <= ((uint32_t)ARENA_POOL_MIN << i))
+			break;
+	return i;
+}
+
+/* Pop head of class [cl] free list, 0 if empty. Free list may have been
+ * overwritten by program, then it is dropped. */
+static uint32_t pool_pop(arena_t *a, lm_t *m, int cl)
+{
+	uint32_t addr = a->pool[cl], tag;
+	uint8_t *hdr, *next;
+
+	if (addr == 0)
+		return 0;
+	hdr = pool_hdr(a, m, addr);
+	next = lm_getelem(m, addr, sizeof(uint32_t));
+	if ((hdr == NULL) || (next == NULL)) {
+		a->pool[cl] = 0;
+		return 0;
+	}
+	memcpy(&tag, hdr, sizeof(tag));
+	if (tag != (POOL_TAG | POOL_FREE | (uint32_t)cl)) {
+		a->pool[cl] = 0;
+		return 0;
+	}
+	memcpy(&a->pool[cl], next, sizeof(uint32_t));
+	return addr;
+}
+
+uint32_t pool_alloc(arena_t *a, lm_t *m, uint32_t sz)
+{
+	int cl = pool_class(sz);
+	uint32_t addr, tag = POOL_TAG | cl;
+	uint8_t *hdr;
+
+	addr = (cl == ARENA_POOLS) ? 0 : pool_pop(a, m, cl);
+	if (addr == 0) {
+		if (cl != ARENA_POOLS)
+			sz = (uint32_t)ARENA_POOL_MIN << cl;
+		if (sz > UINT32_MAX - ARENA_HDR)
+			return 0;
+		addr = arena_alloc(a, m, sz + ARENA_HDR);
+		if (addr == 0)
+			return 0;
+		addr += ARENA_HDR;
+	}
+
+	hdr = pool_hdr(a, m, addr);
+	if (hdr == NULL)
+		return 0;
+	memcpy(hdr, &tag, sizeof(tag));
+	return addr;
+}
+
+int pool_free(arena_t *a, lm_t *m, uint32_t addr, uint32_t sz)
+{
+	int cl = pool_class(sz);
+	uint8_t *hdr = pool_hdr(a, m, addr);
+	uint32_t tag;
+	void *ptr;
+
+	if (hdr == NULL)
+		return 1;
+	memcpy(&tag, hdr, sizeof(tag));
+	if (tag != (POOL_TAG | (uint32_t)cl))
+		return 1;
+	tag |= POOL_FREE;
+	memcpy(hdr, &tag, sizeof(tag));
+	if (cl == ARENA_POOLS)
+		/* Not pooled, reclaimed on reset or release */
+		return 0;
+
+	ptr = lm_getelem(m, addr, sizeof(uint32_t));
+	if (ptr == NULL)
+		return 1;
+	memcpy(ptr, &a->pool[cl], sizeof(uint32_t));
+	a->pool[cl] = addr;
+	return 0;
+}
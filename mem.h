@@ -0,0 +1,113 @@
+#ifndef _MEM_H_
+#define _MEM_H_
+
+/*
+ * mem.h - linear memory definitions
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* System includes */
+#include <stdint.h>
+#include <stddef.h>
+
+/* Linear memory grows in pages of this size */
+#define LM_PAGE 4096
+
+/* Maximum number of base files of linear memory */
+#define LM_LAYERS 8
+
+/* Linear memory
+ *
+ * Whole lm_max bytes of address space are reserved at initialization,
+ * only first lm_size bytes are accessible.
+ *
+ * First lm_base_size bytes may be backed by base files lm_base, mapped
+ * privately, so that writes copy touched pages only. lm_pages holds base
+ * file (top byte) and offset of every page, or LM_ANON for pages never
+ * written. Files are never changed once mapped, clones map the same ones,
+ * later changes go to a new file holding changed pages only.
+ */
+#define LM_ANON UINT64_MAX
+
+struct _lm {
+	uint32_t lm_size;
+	uint32_t lm_max;
+	uint8_t *lm_data;
+	uint32_t lm_base_size;
+	uint32_t lm_layers;
+	int lm_base[LM_LAYERS];
+	uint64_t *lm_pages;
+};
+typedef struct _lm lm_t;
+
+/* Arena allocator
+ *
+ * Allocates from linear memory above its size at the time of first
+ * allocation (base). Memory grown outside the arena (MGROW) is skipped,
+ * reset and release don't go below it (floor). Pools keep free lists of
+ * blocks for ARENA_POOLS size classes (16, 32, ... bytes), next block
+ * address is stored in first 4 bytes of free block. Address 0 is never
+ * allocated.
+ *
+ * Every pool block is preceded by ARENA_HDR bytes holding its size class
+ * (ARENA_POOLS for blocks too big to be pooled) and whether it is free, so
+ * pool_free rejects wrong sizes and double frees.
+ */
+#define ARENA_ALIGN 8
+#define ARENA_POOLS 8
+#define ARENA_POOL_MIN 16
+#define ARENA_HDR ARENA_ALIGN
+
+struct _arena {
+	uint32_t base;
+	uint32_t top;
+	uint32_t floor;
+	uint32_t end;
+	uint32_t pool[ARENA_POOLS];
+};
+typedef struct _arena arena_t;
+
+/* Manipulation functions */
+extern int lm_init(lm_t *, uint32_t);
+extern int lm_destroy(lm_t *);
+extern int lm_grow(lm_t *, uint32_t);
+extern int lm_map(lm_t *, int, uint64_t, uint32_t);
+extern int lm_reset(lm_t *);
+extern int lm_clone(lm_t *, lm_t *);
+extern void *lm_getelem(lm_t *, uint32_t, uint32_t);
+extern uint32_t lm_size(lm_t *);
+extern uint32_t lm_limit(lm_t *);
+
+extern void arena_init(arena_t *);
+extern void arena_reset(arena_t *);
+extern uint32_t arena_alloc(arena_t *, lm_t *, uint32_t);
+extern uint32_t arena_mark(arena_t *, lm_t *);
+extern int arena_release(arena_t *, uint32_t);
+extern uint32_t pool_alloc(arena_t *, lm_t *, uint32_t);
+extern int pool_free(arena_t *, lm_t *, uint32_t, uint32_t);
+
+#endif /* _MEM_H_ */
@@ -0,0 +1,253 @@
+#ifndef _MNEMONIC_H_
+#define _MNEMONIC_H_
+
+/*
+ * mnemonic.h - instruction mnemonics and lengths
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* Local includes */
+#include "ins.h"
+
+/* System includes */
+#include <stdint.h>
+#include <stddef.h>
+
+/* Mnemonics of all instructions, indexed by opcode; NULL if undefined */
+static const char *const in_mnem[256] = {
+	[IN_NOP] = "nop",
+	[IN_END] = "end",
+	[IN_DEBUG] = "debug",
+	[IN_STDCALL] = "stdcall",
+	[IN_SNAPSHOT] = "snapshot",
+
+	[IN_LOAD] = "load",
+	[IN_DUP] = "dup",
+	[IN_GET] = "get",
+	[IN_DROP] = "drop",
+
+	[IN_LDL_1] = "ldl1",
+	[IN_LDL_2] = "ldl2",
+	[IN_LDL_4] = "ldl4",
+	[IN_LDL_8] = "ldl8",
+	[IN_STL_1] = "stl1",
+	[IN_STL_2] = "stl2",
+	[IN_STL_4] = "stl4",
+	[IN_STL_8] = "stl8",
+
+	[IN_BCOPY] = "bcopy",
+	[IN_BFILL] = "bfill",
+	[IN_BCMP] = "bcmp",
+	[IN_BREV] = "brev",
+
+	[IN_ADD_UI] = "add",
+	[IN_ADD_SI] = "sadd",
+	[IN_ADD_UF] = "addf",
+	[IN_ADD_SF] = "saddf",
+
+	[IN_SUB_UI] = "sub",
+	[IN_SUB_SI] = "ssub",
+	[IN_SUB_UF] = "subf",
+	[IN_SUB_SF] = "ssubf",
+
+	[IN_MUL_UI] = "mul",
+	[IN_MUL_SI] = "smul",
+	[IN_MUL_UF] = "mulf",
+	[IN_MUL_SF] = "smulf",
+
+	[IN_DIV_UI] = "div",
+	[IN_DIV_SI] = "sdiv",
+	[IN_DIV_UF] = "divf",
+	[IN_DIV_SF] = "sdivf",
+
+	[IN_MOD_UI] = "mod",
+	[IN_MOD_SI] = "smod",
+
+	[IN_AND] = "and",
+	[IN_AND_L] = "land",
+	[IN_OR] = "or",
+	[IN_OR_L] = "lor",
+	[IN_XOR] = "xor",
+	[IN_XOR_L] = "lxor",
+	[IN_NOT] = "not",
+	[IN_NOT_L] = "lnot",
+	[IN_SHL] = "shl",
+	[IN_SHR] = "shr",
+	[IN_ROTL] = "rotl",
+	[IN_ROTR] = "rotr",
+
+	[IN_JMP] = "jmp",
+	[IN_JMP_L] = "ljmp",
+	[IN_CALL] = "call",
+	[IN_CALL_L] = "lcall",
+	[IN_RET] = "ret",
+	[IN_SWITCH] = "switch",
+	[IN_LOOP] = "loop",
+	[IN_NEXT] = "next",
+	[IN_JMP_D] = "djmp",
+	[IN_CALL_D] = "dcall",
+
+	[IN_CMP] = "cmp",
+	[IN_IFEQ] = "ife",
+	[IN_IFNEQ] = "ifne",
+	[IN_IFGT] = "ifgt",
+	[IN_IFGE] = "ifge",
+	[IN_IFLT] = "iflt",
+	[IN_IFLE] = "ifle",
+	[IN_BEQ] = "beq",
+	[IN_BNE] = "bne",
+	[IN_BGT] = "bgt",
+	[IN_BGE] = "bge",
+	[IN_BLT] = "blt",
+	[IN_BLE] = "ble",
+	[IN_IFOV] = "ifov",
+	[IN_IFNOV] = "ifnov",
+
+	[IN_VADD] = "vadd",
+	[IN_VSUB] = "vsub",
+	[IN_VMUL] = "vmul",
+	[IN_VMIN] = "vmin",
+	[IN_VMAX] = "vmax",
+	[IN_VCMPEQ] = "vcmpeq",
+	[IN_VCMPGT] = "vcmpgt",
+	[IN_VSUM] = "vsum",
+	[IN_VHMIN] = "vhmin",
+	[IN_VHMAX] = "vhmax",
+	[IN_FMA] = "fma",
+	[IN_FDOT] = "fdot",
+	[IN_FSUM] = "fsum",
+	[IN_FMIN] = "fmin",
+	[IN_FMAX] = "fmax",
+
+	[IN_MLOAD] = "mload",
+	[IN_MSTORE] = "mstore",
+	[IN_MSIZE] = "msize",
+	[IN_MGROW] = "mgrow",
+
+	[IN_ADDI_1] = "addi1",
+	[IN_ADDI_2] = "addi2",
+	[IN_ADDI_4] = "addi4",
+	[IN_ADDI_8] = "addi8",
+	[IN_PUSHI_1] = "pushi1",
+	[IN_PUSHI_2] = "pushi2",
+	[IN_PUSHI_4] = "pushi4",
+	[IN_PUSHI_8] = "pushi8",
+	[IN_JMPI] = "jmpi",
+	[IN_JMPW] = "jmpw",
+	[IN_CALLW] = "callw",
+	[IN_GETI] = "geti",
+
+	[IN_RADD] = "radd",
+	[IN_RSUB] = "rsub",
+	[IN_RMUL] = "rmul",
+	[IN_RDIV] = "rdiv",
+	[IN_RMOD] = "rmod",
+	[IN_RAND] = "rand",
+	[IN_ROR] = "ror",
+	[IN_RXOR] = "rxor",
+	[IN_RSHL] = "rshl",
+	[IN_RSHR] = "rshr",
+	[IN_RMOV] = "rmov",
+	[IN_RCMP] = "rcmp",
+	[IN_RLDI] = "rldi",
+	[IN_RPUSH] = "rpush",
+	[IN_RPOP] = "rpop",
+	[IN_RSTDCALL] = "rstdcall",
+
+	[IN_ADDO_UI] = "addo",
+	[IN_ADDO_SI] = "saddo",
+	[IN_SUBO_UI] = "subo",
+	[IN_SUBO_SI] = "ssubo",
+	[IN_MULO_UI] = "mulo",
+	[IN_MULO_SI] = "smulo",
+	[IN_MULW_UI] = "mulw",
+	[IN_MULW_SI] = "smulw",
+
+	[IN_CVT] = "cvt",
+	[IN_CVT_RN] = "cvtrn",
+	[IN_CVT_RD] = "cvtrd",
+	[IN_CVT_RU] = "cvtru",
+};
+
+static inline const char *in_mnemonic(uint8_t opcode)
+{
+	return (in_mnem[opcode] != NULL) ? in_mnem[opcode] : "ndf";
+}
+
+/* Length of instruction [opcode] [arg] including bytes following it */
+static inline uint32_t in_length(uint8_t opcode, uint8_t arg)
+{
+	switch (opcode) {
+		case IN_LOAD :
+			return 2 + arg;
+		case IN_JMP_D :
+		case IN_CALL_D :
+			return 2 + 3 * sizeof(uint32_t);
+		case IN_BEQ :
+		case IN_BNE :
+		case IN_BGT :
+		case IN_BGE :
+		case IN_BLT :
+		case IN_BLE :
+		case IN_LOOP :
+		case IN_NEXT :
+		case IN_JMPW :
+		case IN_CALLW :
+		case IN_GETI :
+			return 2 + sizeof(int32_t);
+		case IN_RADD :
+		case IN_RSUB :
+		case IN_RMUL :
+		case IN_RDIV :
+		case IN_RMOD :
+		case IN_RAND :
+		case IN_ROR :
+		case IN_RXOR :
+		case IN_RSHL :
+		case IN_RSHR :
+			return 2 + 3;
+		case IN_RMOV :
+		case IN_RCMP :
+			return 2 + 2;
+		case IN_RPUSH :
+		case IN_RPOP :
+		case IN_RSTDCALL :
+		case IN_CVT :
+		case IN_CVT_RN :
+		case IN_CVT_RD :
+		case IN_CVT_RU :
+			return 2 + 1;
+		case IN_RLDI :
+			return 2 + sizeof(uint64_t);
+		case IN_SWITCH :
+			return 2 + (1 + (arg ? arg : 256)) * sizeof(uint32_t);
+		default :
+			return 2;
+	}
+}
+
+#endif /* _MNEMONIC_H_ */
@@ -0,0 +1,231 @@
+/*
+ * module.c - native function registry and extension module loader
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* Local includes */
+#include "module.h"
+
+/* System includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+
+/* Registered functions by stdcall ID */
+static const func_desc_t *func_reg[FUNC_MAX];
+
+/* Loaded modules */
+static void *mod_tbl[MODULE_MAX];
+static int mod_count = 0;
+
+/* Compiled signatures by stdcall ID */
+static func_sig_t func_sigs[FUNC_MAX];
+
+/* Compile signature, returns 0 when it's valid */
+static int func_sig_compile(const char *sig, func_sig_t *out)
+{
+	uint8_t w;
+
+	out->argc = 0;
+	while (*sig) {
+		if (*sig == ' ') {
+			sig++;
+			continue;
+		}
+		if ((sig[0] == 'b') && ((sig[1] == ' ') || (sig[1] == '\0'))) {
+			/* bytes need integer length before them */
+			if ((out->argc == 0)
+				|| (out->width[out->argc - 1] == 0))
+				return 1;
+			w = 0;
+			sig += 1;
+		} else if (((sig[0] == 'i') || (sig[0] == 'u')
+				|| (sig[0] == 'f'))
+			&& ((sig[2] == ' ') || (sig[2] == '\0'))) {
+			w = sig[1] - '0';
+			if ((w != 1) && (w != 2) && (w != 4) && (w != 8))
+				return 1;
+			if ((sig[0] == 'f') && (w < 4))
+				return 1;
+			sig += 2;
+		} else return 1;
+
+		if (out->argc == FUNC_ARGS_MAX)
+			return 1;
+		out->width[out->argc++] = w;
+	}
+	return 0;
+}
+
+/* Register function under ID, signature (if any) must match arity */
+int func_register(uint8_t id, const func_desc_t *desc)
+{
+	func_sig_t sig;
+
+	if ((id == 0) || (desc->name == NULL))
+		return 1;
+	sig.argc = 0;
+	if ((desc->sig != NULL) && ((func_sig_compile(desc->sig, &sig) != 0)
+		|| (sig.argc != desc->arity)))
+		return 2;
+	if ((func_reg[id] != NULL) && (func_reg[id] != desc))
+		return 3;
+	func_reg[id] = desc;
+	func_sigs[id] = sig;
+	return 0;
+}
+
+const func_desc_t *func_desc(uint8_t id)
+{
+	return func_reg[id];
+}
+
+/* Signature of function, NULL if it has none */
+const func_sig_t *func_sig(uint8_t id)
+{
+	if ((func_reg[id] == NULL) || (func_reg[id]->sig == NULL))
+		return NULL;
+	return &func_sigs[id];
+}
+
+/* Find stdcall ID of function, -1 if unknown */
+int func_lookup(const char *name)
+{
+	int i;
+
+	for (i = 1; i < FUNC_MAX; i++)
+		if ((func_reg[i] != NULL) && !strcmp(func_reg[i]->name, name))
+			return i;
+	return -1;
+}
+
+/* Read imports of object [fname] from [fname].imp
+ *
+ * [map] (FUNC_MAX entries) gets ID of registered function for every ID
+ * used by the object, IDs not listed map to themselves. Returns 1 when
+ * imports were read, 0 if object has none and -1 if some function isn't
+ * registered.
+ */
+int func_imports(const char *fname, uint8_t *map)
+{
+	FILE *f;
+	char *path, line[256], name[256];
+	unsigned int id;
+	int i, ret = 1;
+
+	for (i = 0; i < FUNC_MAX; i++)
+		map[i] = (uint8_t)i;
+
+	path = (char *)malloc(strlen(fname) + sizeof(".imp"));
+	if (path == NULL)
+		return -1;
+	sprintf(path, "%s.imp", fname);
+	f = fopen(path, "r");
+	free(path);
+	if (f == NULL)
+		return 0;
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if ((line[0] == ';')
+			|| (sscanf(line, "%x %255s", &id, name) != 2))
+			continue;
+		i = func_lookup(name);
+		if ((id == 0) || (id >= FUNC_MAX) || (i == -1)) {
+			fprintf(stderr, "E: Can't bind \'%s\' imported by "
+					"\'%s\'\n", name, fname);
+			ret = -1;
+			break;
+		}
+		map[id] = (uint8_t)i;
+	}
+	fclose(f);
+
+	return ret;
+}
+
+/* Load module and register its functions, returns count of them or -1 */
+int func_module_load(const char *fname)
+{
+	void *handle;
+	const module_t *mod;
+	const func_desc_t *f;
+	int id, ret = 0;
+
+	if (mod_count >= MODULE_MAX) {
+		fprintf(stderr, "E: Too many modules\n");
+		return -1;
+	}
+
+	handle = dlopen(fname, RTLD_LAZY | RTLD_LOCAL);
+	if (handle == NULL) {
+		fprintf(stderr, "E: %s\n", dlerror());
+		return -1;
+	}
+
+	mod = (const module_t *)dlsym(handle, AUVM_MODULE_SYM);
+	if ((mod == NULL) || (mod->version != AUVM_MODULE_VERSION)) {
+		fprintf(stderr, "E: \'%s\' is not AUVM module\n", fname);
+		dlclose(handle);
+		return -1;
+	}
+
+	/* First free ID above the ones of already loaded modules */
+	for (id = FUNC_MAX - 1; id >= FUNC_MODULE_BASE; id--)
+		if (func_reg[id] != NULL)
+			break;
+	id++;
+	if (id < FUNC_MODULE_BASE)
+		id = FUNC_MODULE_BASE;
+
+	for (f = mod->funcs; f->name != NULL; f++, id++, ret++) {
+		if ((id >= FUNC_MAX) || (func_lookup(f->name) != -1)
+			|| (func_register((uint8_t)id, f) != 0)) {
+			fprintf(stderr, "E: Can't register \'%s\' from \'%s\'\n",
+					f->name, fname);
+			/* Roll back functions of this module */
+			while (ret--)
+				func_reg[--id] = NULL;
+			dlclose(handle);
+			return -1;
+		}
+	}
+
+	mod_tbl[mod_count++] = handle;
+	return ret;
+}
+
+/* Unregister module functions and unload all modules */
+void func_module_unload(void)
+{
+	int i;
+
+	for (i = FUNC_MODULE_BASE; i < FUNC_MAX; i++)
+		func_reg[i] = NULL;
+	while (mod_count > 0)
+		dlclose(mod_tbl[--mod_count]);
+}
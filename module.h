@@ -0,0 +1,121 @@
+#ifndef _MODULE_H_
+#define _MODULE_H_
+
+/*
+ * module.h - native function registry and extension module interface
+ *
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* System includes */
+#include <stdint.h>
+#include <stddef.h>
+
+struct _vm;
+
+/* Argument of native function, points into data stack */
+struct _func_arg {
+	void *ptr;
+	uint32_t len;
+};
+typedef struct _func_arg func_arg_t;
+
+/* Value of argument [i] of given C type, and bytes argument */
+#define FUNC_ARG(args, i, type) (*(type *)((args)[i].ptr))
+#define FUNC_BYTES(args, i) ((const char *)((args)[i].ptr))
+
+/* Function wrapper prototype */
+typedef int (*func_wrap_t)(struct _vm *, const func_arg_t *);
+
+/* Native function descriptor
+ *
+ * Signature lists arguments in order they are popped from stack, separated
+ * by spaces:
+ *  - i1, i2, i4, i8 - signed integers
+ *  - u1, u2, u4, u8 - unsigned integers
+ *  - f4, f8 - float and double
+ *  - b - bytes, count is given by preceding integer argument
+ *
+ * Arguments are popped and checked before the wrapper is called and passed
+ * to it as pointers into the stack; bytes are put back to order in which
+ * they were written in LOAD. Wrapper of function without signature (NULL)
+ * gets no arguments and pops them itself.
+ */
+struct _func_desc {
+	const char *name;
+	func_wrap_t func;
+	uint8_t arity;
+	const char *sig;
+};
+typedef struct _func_desc func_desc_t;
+
+/* Compiled signature, width of each argument (0 for bytes) */
+#define FUNC_ARGS_MAX 16
+
+struct _func_sig {
+	uint8_t argc;
+	uint8_t width[FUNC_ARGS_MAX];
+};
+typedef struct _func_sig func_sig_t;
+
+/* Extension module
+ *
+ * Shared object exports module_t named AUVM_MODULE_SYM, its functions
+ * (terminated by entry with NULL name) get stdcall IDs from
+ * FUNC_MODULE_BASE up, in order of loading.
+ *
+ * Objects shouldn't depend on that order: [object].imp lists functions
+ * object calls, every line has hexadecimal ID used by its STDCALL and
+ * RSTDCALL instructions and name of the function (lines starting with ';'
+ * are comments). These IDs are bound to registered functions of the same
+ * names when the object is loaded.
+ */
+#define AUVM_MODULE_VERSION 2
+#define AUVM_MODULE_SYM "auvm_module"
+
+struct _module {
+	uint32_t version;
+	const char *name;
+	const func_desc_t *funcs;
+};
+typedef struct _module module_t;
+
+/* IDs below this are reserved for AUVM Library */
+#define FUNC_MODULE_BASE 0x40
+#define FUNC_MAX 256
+#define MODULE_MAX 16
+
+/* Externs - module.c */
+extern int func_register(uint8_t, const func_desc_t *);
+extern const func_desc_t *func_desc(uint8_t);
+extern const func_sig_t *func_sig(uint8_t);
+extern int func_lookup(const char *);
+extern int func_imports(const char *, uint8_t *);
+extern int func_module_load(const char *);
+extern void func_module_unload(void);
+
+#endif /* _MODULE_H_ */
@@ -30,14 +30,19 @@
 /* Local includes */
 #include "auvm.h"
 #include "object.h"
+#include "mnemonic.h"
 
 /* System includes */
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
+
+const char *obj_cache_dir = NULL;
 
 /* Get object type 
  * FIXME: Determines *every* file as raw binary
@@ -49,8 +54,308 @@ uint8_t obj_type(int fd)
 	else return 0;
 }
 
-/* Load object */
-int obj_load(obj_t *o, char *fname)
+static int sym_cmp(const void *a, const void *b)
+{
+	uint32_t x = ((const sym_t *)a)->addr, y = ((const sym_t *)b)->addr;
+
+	return (x > y) - (x < y);
+}
+
+/* Load symbol table from [fname].sym if it exists
+ *
+ * Every line contains hexadecimal address and name separated by whitespace,
+ * lines starting with ';' are comments.
+ */
+static void obj_load_syms(obj_t *o, const char *fname)
+{
+	FILE *f;
+	char *path, line[256], name[256];
+	unsigned int addr;
+	uint32_t max = 0;
+	sym_t *tmp;
+
+	o->sym_count = 0;
+	o->syms = NULL;
+
+	path = (char *)malloc(strlen(fname) + sizeof(".sym"));
+	if (path == NULL)
+		return;
+	sprintf(path, "%s.sym", fname);
+	f = fopen(path, "r");
+	free(path);
+	if (f == NULL)
+		return;
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if ((line[0] == ';')
+			|| (sscanf(line, "%x %255s", &addr, name) != 2))
+			continue;
+		if (o->sym_count == max) {
+			max = (max == 0) ? 16 : max * 2;
+			tmp = (sym_t *)realloc(o->syms, sizeof(sym_t) * max);
+			if (tmp == NULL)
+				break;
+			o->syms = tmp;
+		}
+		o->syms[o->sym_count].addr = addr;
+		o->syms[o->sym_count].name = strdup(name);
+		if (o->syms[o->sym_count].name == NULL)
+			break;
+		o->sym_count++;
+	}
+	fclose(f);
+
+	qsort(o->syms, o->sym_count, sizeof(sym_t), &sym_cmp);
+}
+
+/* Name of symbol at [addr] or NULL */
+const char *obj_symbol(obj_t *o, uint32_t addr)
+{
+	uint32_t lo = 0, hi = o->sym_count, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (o->syms[mid].addr < addr)
+			lo = mid + 1;
+		else hi = mid;
+	}
+	if ((lo < o->sym_count) && (o->syms[lo].addr == addr))
+		return o->syms[lo].name;
+	return NULL;
+}
+
+#define IMAP_SIZE(sz) (((sz) + 7) / 8)
+
+/* Build decoded form of loaded object */
+static int obj_decode(obj_t *o)
+{
+	uint32_t addr, len;
+
+	o->imap = (uint8_t *)calloc(IMAP_SIZE(o->sz) + 1, 1);
+	if (o->imap == NULL)
+		return 1;
+	o->verified = 1;
+
+	for (addr = 0; addr < o->sz; addr += len) {
+		o->imap[addr / 8] |= 1 << (addr % 8);
+		if ((in_mnem[o->data[addr]] == NULL) || (addr + 1 >= o->sz)) {
+			o->verified = 0;
+			break;
+		}
+		len = in_length(o->data[addr], o->data[addr + 1]);
+	}
+	if (addr != o->sz)
+		o->verified = 0;
+	return 0;
+}
+
+/* Bind stdcall IDs by imports of object, nonzero if some can't be bound
+ *
+ * Arguments of STDCALL and RSTDCALL found by linear sweep are rewritten
+ * once here, so calls cost the same as without imports. Sweep can't see
+ * calls of unverified object past its data, so such object can't have
+ * imports.
+ */
+static int obj_bind(obj_t *o)
+{
+	uint8_t map[FUNC_MAX], *p;
+	uint32_t addr;
+	int ret;
+
+	ret = func_imports(o->filename, map);
+	if (ret <= 0)
+		return ret;
+	if (!o->verified) {
+		fprintf(stderr, "E: Can't bind imports of unverified object "
+				"\'%s\'\n", o->filename);
+		return 1;
+	}
+
+	for (addr = 0; addr + 1 < o->sz; addr += in_length(p[0], p[1])) {
+		p = &o->data[addr];
+		if ((p[0] == IN_STDCALL) || (p[0] == IN_RSTDCALL))
+			p[1] = map[p[1]];
+	}
+	return 0;
+}
+
+/* Nonzero if [addr] can be jumped to: inside of object and, if object is
+ * verified, at start of instruction */
+int obj_target(const obj_t *o, uint32_t addr)
+{
+	if (addr >= o->sz)
+		return 0;
+	if (!o->verified)
+		return 1;
+	return (o->imap[addr / 8] >> (addr % 8)) & 1;
+}
+
+/* Hash of instruction set as obj_decode sees it */
+static uint64_t obj_cache_isa(void)
+{
+	static uint64_t isa = 0;
+	uint64_t op[256];
+	uint32_t len[256];
+	unsigned int i, j;
+
+	if (isa != 0)
+		return isa;
+	for (i = 0; i < 256; i++) {
+		for (j = 0; j < 256; j++)
+			len[j] = in_length(i, j);
+		op[i] = hash64(len, sizeof(len));
+		if (in_mnem[i] != NULL)
+			op[i] ^= hash64(in_mnem[i], strlen(in_mnem[i]) + 1);
+	}
+	isa = hash64(op, sizeof(op));
+	return isa;
+}
+
+/* Path of cache file for object file [sbuf] */
+static char *obj_cache_path(const struct stat *sbuf)
+{
+	char *path;
+
+	path = (char *)malloc(strlen(obj_cache_dir) + 80);
+	if (path != NULL)
+		sprintf(path, "%s/%llx-%llx-%016llx.%u", obj_cache_dir,
+				(unsigned long long)sbuf->st_dev,
+				(unsigned long long)sbuf->st_ino,
+				(unsigned long long)obj_cache_isa(),
+				OBJ_CACHE_VERSION);
+	return path;
+}
+
+/* Map decoded form of object read from file [fsb] from cache, nonzero if
+ * it isn't there or object changed since */
+static int obj_cache_load(obj_t *o, const struct stat *fsb)
+{
+	const obj_cache_hdr_t *hdr;
+	const uint8_t *raw;
+	struct stat sbuf;
+	char *path;
+	void *map;
+	int fd;
+
+	path = obj_cache_path(fsb);
+	if (path == NULL)
+		return 1;
+	fd = open(path, O_RDONLY);
+	free(path);
+	if (fd == -1)
+		return 1;
+	if ((fstat(fd, &sbuf) == -1)
+		|| ((size_t)sbuf.st_size < sizeof(obj_cache_hdr_t))) {
+		close(fd);
+		return 1;
+	}
+	map = mmap(NULL, sbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return 1;
+
+	hdr = (const obj_cache_hdr_t *)map;
+	raw = (const uint8_t *)(hdr + 1);
+	if ((memcmp(hdr->magic, OBJ_CACHE_MAGIC, sizeof(hdr->magic)) != 0)
+		|| (hdr->version != OBJ_CACHE_VERSION)
+		|| (hdr->sz != o->sz) || (hdr->isa != obj_cache_isa())
+		|| (hdr->mtime != (uint64_t)fsb->st_mtim.tv_sec)
+		|| (hdr->mtime_ns != (uint64_t)fsb->st_mtim.tv_nsec)
+		|| (hdr->imap_size != IMAP_SIZE(o->sz) + 1)
+		|| (sizeof(obj_cache_hdr_t) + (size_t)hdr->sz + hdr->imap_size
+			> (size_t)sbuf.st_size)
+		|| (memcmp(raw, o->data, o->sz) != 0)) {
+		munmap(map, sbuf.st_size);
+		return 1;
+	}
+
+	o->imap = (uint8_t *)(raw + hdr->sz);
+	o->verified = (uint8_t)hdr->verified;
+	o->cached = map;
+	o->cached_len = sbuf.st_size;
+	return 0;
+}
+
+/* Store decoded form of object read from file [fsb] into cache, errors
+ * are ignored */
+static void obj_cache_store(obj_t *o, const struct stat *fsb)
+{
+	obj_cache_hdr_t hdr;
+	char *path, *tmp;
+	FILE *f;
+	int err;
+
+	path = obj_cache_path(fsb);
+	if (path == NULL)
+		return;
+	tmp = (char *)malloc(strlen(path) + 32);
+	if (tmp == NULL) {
+		free(path);
+		return;
+	}
+	/* Concurrent writers each use their own file */
+	sprintf(tmp, "%s.%ld.tmp", path, (long)getpid());
+	mkdir(obj_cache_dir, 0755);
+	f = fopen(tmp, "wb");
+	if (f != NULL) {
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.magic, OBJ_CACHE_MAGIC, sizeof(hdr.magic));
+		hdr.version = OBJ_CACHE_VERSION;
+		hdr.sz = o->sz;
+		hdr.isa = obj_cache_isa();
+		hdr.mtime = (uint64_t)fsb->st_mtim.tv_sec;
+		hdr.mtime_ns = (uint64_t)fsb->st_mtim.tv_nsec;
+		hdr.verified = o->verified;
+		hdr.imap_size = IMAP_SIZE(o->sz) + 1;
+		fwrite(&hdr, sizeof(hdr), 1, f);
+		fwrite(o->data, 1, o->sz, f);
+		fwrite(o->imap, 1, hdr.imap_size, f);
+		err = ferror(f);
+		if ((fclose(f) != 0) || err || (rename(tmp, path) != 0))
+			unlink(tmp);
+	}
+	free(tmp);
+	free(path);
+}
+
+/* Drop contents and decoded form of object that failed to load */
+static void obj_drop(obj_t *o)
+{
+	if (o->cached != NULL)
+		munmap(o->cached, o->cached_len);
+	else free(o->imap);
+	o->cached = NULL;
+	o->imap = NULL;
+	free(o->data);
+	o->data = NULL;
+	o->sz = 0;
+	o->type = OBJ_UNKNOWN;
+}
+
+/* Register object [fname] without reading it, see obj_require */
+int obj_register(obj_t *o, const char *fname)
+{
+	o->type = OBJ_UNKNOWN;
+	o->sz = 0;
+	o->data = NULL;
+	o->sym_count = 0;
+	o->syms = NULL;
+	o->filename = NULL;
+	o->imap = NULL;
+	o->verified = 0;
+	o->cached = NULL;
+	o->cached_len = 0;
+
+	if (access(fname, R_OK) != 0)
+		return 1;
+	o->filename = strdup(fname);
+	if (o->filename == NULL)
+		return 3;
+	return 0;
+}
+
+/* Load registered object, unless it's already loaded */
+int obj_require(obj_t *o)
 {
 	int fd;
 	struct stat sbuf;
@@ -58,17 +363,24 @@ int obj_load(obj_t *o, char *fname)
 	uint8_t ftype;
 	ssize_t ret;
 
+	if (o->type != OBJ_UNKNOWN)
+		return 0;
+
 	/* Operations:
 	 *  1. open file
 	 *  2. get file type
 	 *  3. parse it based on type
 	 */
-	fd = open(fname, O_RDONLY);
-	if (fd == -1)
+	fd = open(o->filename, O_RDONLY);
+	if (fd == -1) {
+		fprintf(stderr, "E: Can't open object \'%s\'\n", o->filename);
 		return 1;
+	}
 	ftype = obj_type(fd);
-	if (fstat(fd, &sbuf) == -1)
+	if (fstat(fd, &sbuf) == -1) {
+		close(fd);
 		return 2;
+	}
 	/* get file size */
 	fsize = (uint32_t) sbuf.st_size;
 
@@ -80,10 +392,12 @@ int obj_load(obj_t *o, char *fname)
 			 *  3. Return
 			 */
 			o->data = (uint8_t *)malloc(fsize);
-			if (o->data == NULL)
+			if (o->data == NULL) {
+				close(fd);
 				return 3;
+			}
 			ret = read(fd, o->data, fsize);
-			o->sz = (uint32_t) ret;
+			o->sz = (ret < 0) ? 0 : (uint32_t) ret;
 			break;
 		case OBJ_BIN_UEX :
 			/* Native executable format */
@@ -92,21 +406,62 @@ int obj_load(obj_t *o, char *fname)
 		case OBJ_UNKNOWN :
 		default :
 			fprintf(stderr, "E: Unknown object type for \'%s\'\n",
-					fname);
+					o->filename);
+			close(fd);
 			return 4;
 	}
 
 	o->type = ftype;
-	o->filename = fname;
 	close(fd);
 
+	if ((obj_cache_dir == NULL) || (obj_cache_load(o, &sbuf) != 0)) {
+		if (obj_decode(o) != 0) {
+			obj_drop(o);
+			return 3;
+		}
+		if (obj_cache_dir != NULL)
+			obj_cache_store(o, &sbuf);
+	}
+
+	if (obj_bind(o) != 0) {
+		obj_drop(o);
+		return 5;
+	}
+	obj_load_syms(o, o->filename);
+
 	return 0;
 }
 
+/* Load object */
+int obj_load(obj_t *o, const char *fname)
+{
+	int ret;
+
+	ret = obj_register(o, fname);
+	if ((ret == 0) && ((ret = obj_require(o)) != 0)) {
+		free(o->filename);
+		o->filename = NULL;
+	}
+	return ret;
+}
+
 /* Unload object */
 void obj_unload(obj_t *o)
 {
+	uint32_t i;
+
+	for (i = 0; i < o->sym_count; i++)
+		free(o->syms[i].name);
+	free(o->syms);
+	o->syms = NULL;
+	o->sym_count = 0;
+	if (o->cached != NULL)
+		munmap(o->cached, o->cached_len);
+	else free(o->imap);
+	o->cached = NULL;
+	o->imap = NULL;
 	free(o->data);
+	free(o->filename);
 	o->type = 0;
 	o->sz = 0;
 	o->filename = NULL;
@@ -41,20 +41,70 @@ struct _ip {
 };
 typedef struct _ip ip_t;
 
-/* Object structure */
+/* Symbol, address of named location in object */
+struct _sym {
+	uint32_t addr;
+	char *name;
+};
+typedef struct _sym sym_t;
+
+/* Object structure
+ *
+ * Registered object has only its filename set and type OBJ_UNKNOWN until
+ * it's loaded by obj_require.
+ */
 struct _obj {
 	char *filename;
 	uint8_t type;
 	uint32_t sz;
 	uint8_t *data;
+	/* symbol table sorted by address, may be empty */
+	uint32_t sym_count;
+	sym_t *syms;
+	/* decoded form: bitmap of instruction starts found by linear sweep,
+	 * verified if all of them are defined and object ends with last one */
+	uint8_t *imap;
+	uint8_t verified;
+	/* mapping of cache file imap points into, NULL if allocated */
+	void *cached;
+	size_t cached_len;
 };
 
 typedef struct _obj obj_t;
 
 /* Functions */
 extern uint8_t obj_type(int fd);
-extern int obj_load(obj_t *o, char *fname);
+extern int obj_register(obj_t *o, const char *fname);
+extern int obj_require(obj_t *o);
+extern int obj_load(obj_t *o, const char *fname);
 extern void obj_unload(obj_t *o);
+extern const char *obj_symbol(obj_t *o, uint32_t addr);
+extern int obj_target(const obj_t *o, uint32_t addr);
+
+/* Directory of decoded objects, NULL if they aren't cached */
+extern const char *obj_cache_dir;
+
+/* Cache file format, bump on change of entry layout or decoding algorithm
+ *
+ * Entry is named by device and inode of object file and hash of instruction
+ * set (defined opcodes and their lengths), which decoded form depends on.
+ * Header is followed by raw bytes of object, compared before entry is
+ * trusted, and its imap.
+ */
+#define OBJ_CACHE_MAGIC "AUVMOBJC"
+#define OBJ_CACHE_VERSION 9
+
+struct _obj_cache_hdr {
+	char magic[8];
+	uint32_t version;
+	uint32_t sz;
+	uint64_t isa;
+	uint64_t mtime;
+	uint64_t mtime_ns;
+	uint32_t verified;
+	uint32_t imap_size;
+};
+typedef struct _obj_cache_hdr obj_cache_hdr_t;
 
 /* Object types */
 #define OBJ_UNKNOWN 0
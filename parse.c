@@ -42,6 +42,12 @@ int parse(vm_t *vm_status)
 	uint32_t objno, addr, tmp;
 	in_t func;
 	int ret;
+	uint64_t t0 = 0;
+
+	if (prof_sample_pending)
+		prof_sample(vm_status);
+	if (vm_status->prof != NULL)
+		t0 = prof_clock();
 
 	objno = vm_status->nip.obj;
 	addr = vm_status->nip.addr;
@@ -66,7 +72,11 @@ int parse(vm_t *vm_status)
 		func = vm_status->in_table[in_num];
 		ret = (*func)(vm_status, in_num, in_arg);
 	}
-	
+
+	if (vm_status->prof != NULL)
+		prof_record(vm_status->prof, in_num, in_arg,
+				prof_clock() - t0);
+
 	if (vm_status->flags & FLAGS_DBG) {
 		printf("INSTRUCTION: %.2x %.2x", in_num, in_arg);
 		ds_show(&vm_status->ds);
@@ -74,3 +84,12 @@ int parse(vm_t *vm_status)
 
 	return ret;
 }
+
+/* Execute until END, return its argument, or -1 if instruction failed */
+int auvm_run(vm_t *vm_status)
+{
+	while (!(vm_status->flags & FLAGS_HALT))
+		if (parse(vm_status) != 0)
+			return -1;
+	return vm_status->exit_code;
+}
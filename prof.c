@@ -0,0 +1,364 @@
+/*
+ * prof.c - instruction profiling
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* Local includes */
+#include "auvm.h"
+#include "prof.h"
+#include "mnemonic.h"
+
+/* System includes */
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+/* Sampled call stack */
+struct _stack {
+	uint64_t hash;
+	uint64_t count;
+	uint32_t depth;
+	ip_t *ips;
+};
+
+/* Sampler state, there is only one timer per process */
+static struct {
+	const char *path;
+	struct _stack *tbl;
+	uint32_t used;
+	uint32_t size;
+	ip_t *buf;
+	uint32_t buf_sz;
+} sampler;
+
+volatile sig_atomic_t prof_sample_pending = 0;
+
+volatile sig_atomic_t prof_dump = 0;
+
+static void prof_sigusr1(int UNUSED(sig))
+{
+	prof_dump = 1;
+}
+
+prof_t *prof_init(void)
+{
+	prof_t *ret;
+	struct sigaction sa;
+
+	ret = (prof_t *)calloc(1, sizeof(prof_t));
+	if (ret == NULL)
+		return NULL;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = &prof_sigusr1;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGUSR1, &sa, NULL);
+
+	return ret;
+}
+
+void prof_destroy(prof_t *p)
+{
+	signal(SIGUSR1, SIG_DFL);
+	free(p);
+}
+
+/* Cycle count below which [pct] percent of executions of opcode fall */
+static uint64_t prof_percentile(prof_t *p, int opcode, uint64_t pct)
+{
+	uint64_t seen = 0;
+	int b;
+
+	for (b = 0; b < PROF_BUCKETS; b++) {
+		seen += p->hist[opcode][b];
+		if (seen * 100 >= p->count[opcode] * pct)
+			break;
+	}
+	return (b < PROF_BUCKETS - 1) ? (2ULL << b) - 1 : UINT64_MAX;
+}
+
+/* Sort indices in [order] by descending [key], n is at most 256 */
+static void prof_sort(int *order, int n, const uint64_t *key)
+{
+	int i, j, t;
+
+	for (i = 1; i < n; i++) {
+		t = order[i];
+		for (j = i; j > 0 && key[order[j - 1]] < key[t]; j--)
+			order[j] = order[j - 1];
+		order[j] = t;
+	}
+}
+
+void prof_report(prof_t *p, FILE *s)
+{
+	int order[256];
+	uint64_t total_count = 0, total_cycles = 0;
+	const func_desc_t *desc;
+	int i, n;
+
+	for (i = 0; i < 256; i++) {
+		total_count += p->count[i];
+		total_cycles += p->cycles[i];
+	}
+
+	/* Opcodes by total time spent in them */
+	for (i = n = 0; i < 256; i++)
+		if (p->count[i] != 0)
+			order[n++] = i;
+	prof_sort(order, n, p->cycles);
+
+	fprintf(s, "\nPROFILE: %llu instructions, %llu cycles\n",
+			(unsigned long long)total_count,
+			(unsigned long long)total_cycles);
+	fprintf(s, "%-8s %4s %12s %6s %14s %6s %8s %8s %8s\n", "insn", "op",
+			"count", "count%", "cycles", "time%", "avg", "p50<",
+			"p99<");
+	for (i = 0; i < n; i++) {
+		int op = order[i];
+
+		fprintf(s, "%-8s 0x%.2x %12llu %6.2f %14llu %6.2f %8.1f "
+				"%8llu %8llu\n", in_mnemonic(op), op,
+				(unsigned long long)p->count[op],
+				100.0 * p->count[op] / total_count,
+				(unsigned long long)p->cycles[op],
+				100.0 * p->cycles[op] / total_cycles,
+				(double)p->cycles[op] / p->count[op],
+				(unsigned long long)prof_percentile(p, op, 50),
+				(unsigned long long)prof_percentile(p, op, 99));
+	}
+
+	/* Standard function calls by count */
+	for (i = n = 0; i < 256; i++)
+		if (p->calls[i] != 0)
+			order[n++] = i;
+	if (n == 0)
+		return;
+	prof_sort(order, n, p->calls);
+
+	fprintf(s, "\n%-16s %4s %12s\n", "stdcall", "id", "count");
+	for (i = 0; i < n; i++) {
+		desc = func_desc(order[i]);
+		fprintf(s, "%-16s 0x%.2x %12llu\n",
+				(desc != NULL) ? desc->name : "undefined",
+				order[i], (unsigned long long)p->calls[order[i]]);
+	}
+}
+
+static void prof_sigprof(int UNUSED(sig))
+{
+	prof_sample_pending = 1;
+}
+
+int prof_sample_start(const char *path, unsigned int hz)
+{
+	struct sigaction sa;
+	struct itimerval it;
+
+	if (hz == 0)
+		hz = PROF_SAMPLE_HZ;
+
+	sampler.size = 1024;
+	sampler.used = 0;
+	sampler.tbl = (struct _stack *)calloc(sampler.size,
+			sizeof(struct _stack));
+	if (sampler.tbl == NULL)
+		return 1;
+	sampler.path = path;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = &prof_sigprof;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGPROF, &sa, NULL);
+
+	it.it_interval.tv_sec = 0;
+	it.it_interval.tv_usec = (hz > 1000000) ? 1 : 1000000 / hz;
+	it.it_value = it.it_interval;
+	if (setitimer(ITIMER_PROF, &it, NULL) != 0) {
+		free(sampler.tbl);
+		sampler.tbl = NULL;
+		return 2;
+	}
+
+	return 0;
+}
+
+/* Insert stack into table (which must have free slot) */
+static struct _stack *prof_stack_slot(uint64_t hash, const ip_t *ips,
+		uint32_t depth)
+{
+	struct _stack *st;
+	uint32_t i;
+
+	for (i = hash & (sampler.size - 1); ; i = (i + 1) & (sampler.size - 1)) {
+		st = &sampler.tbl[i];
+		if (st->ips == NULL)
+			return st;
+		if ((st->hash == hash) && (st->depth == depth)
+			&& (memcmp(st->ips, ips, sizeof(ip_t) * depth) == 0))
+			return st;
+	}
+}
+
+static int prof_stack_grow(void)
+{
+	struct _stack *old = sampler.tbl, *st;
+	uint32_t i, old_sz = sampler.size;
+
+	sampler.tbl = (struct _stack *)calloc(old_sz * 2,
+			sizeof(struct _stack));
+	if (sampler.tbl == NULL) {
+		sampler.tbl = old;
+		return 1;
+	}
+	sampler.size = old_sz * 2;
+
+	for (i = 0; i < old_sz; i++)
+		if (old[i].ips != NULL) {
+			st = prof_stack_slot(old[i].hash, old[i].ips,
+					old[i].depth);
+			*st = old[i];
+		}
+	free(old);
+
+	return 0;
+}
+
+void prof_sample(vm_t *vm_status)
+{
+	struct _stack *st;
+	uint32_t i, depth;
+	uint64_t hash = 14695981039346656037ULL;
+	ip_t *tmp;
+
+	prof_sample_pending = 0;
+	if (sampler.tbl == NULL)
+		return;
+
+	/* Program entry followed by entries of all called functions and
+	 * instruction about to be executed */
+	depth = vm_status->cs.st_count + 2;
+	if (sampler.buf_sz < depth) {
+		tmp = (ip_t *)realloc(sampler.buf, sizeof(ip_t) * depth);
+		if (tmp == NULL)
+			return;
+		sampler.buf = tmp;
+		sampler.buf_sz = depth;
+	}
+	sampler.buf[0].obj = 0;
+	sampler.buf[0].addr = 0;
+	for (i = 1; i < depth - 1; i++)
+		sampler.buf[i] = vm_status->cs.st_data[i - 1].entry;
+	sampler.buf[depth - 1] = vm_status->nip;
+
+	/* FNV-1a */
+	for (i = 0; i < depth; i++) {
+		hash = (hash ^ sampler.buf[i].addr) * 1099511628211ULL;
+		hash = (hash ^ sampler.buf[i].obj) * 1099511628211ULL;
+	}
+
+	if ((sampler.used + 1) * 2 > sampler.size && prof_stack_grow() != 0)
+		return;
+
+	st = prof_stack_slot(hash, sampler.buf, depth);
+	if (st->ips == NULL) {
+		st->ips = (ip_t *)malloc(sizeof(ip_t) * depth);
+		if (st->ips == NULL)
+			return;
+		memcpy(st->ips, sampler.buf, sizeof(ip_t) * depth);
+		st->hash = hash;
+		st->depth = depth;
+		st->count = 0;
+		sampler.used++;
+	}
+	st->count++;
+}
+
+static void prof_frame_name(vm_t *vm_status, ip_t ip, FILE *f)
+{
+	const char *name = NULL, *base;
+
+	if (ip.obj < vm_status->obj_count)
+		name = obj_symbol(&vm_status->ctbl[ip.obj], ip.addr);
+	if (name != NULL) {
+		fputs(name, f);
+		return;
+	}
+
+	if (ip.obj < vm_status->obj_count) {
+		base = strrchr(vm_status->ctbl[ip.obj].filename, '/');
+		base = (base != NULL) ? base + 1
+			: vm_status->ctbl[ip.obj].filename;
+		fprintf(f, "%s:0x%x", base, ip.addr);
+	} else fprintf(f, "%u:0x%x", ip.obj, ip.addr);
+}
+
+int prof_sample_stop(vm_t *vm_status)
+{
+	struct itimerval it;
+	FILE *f;
+	uint32_t i, j;
+	int ret = 0;
+
+	if (sampler.tbl == NULL)
+		return 0;
+
+	memset(&it, 0, sizeof(it));
+	setitimer(ITIMER_PROF, &it, NULL);
+	signal(SIGPROF, SIG_DFL);
+
+	f = fopen(sampler.path, "w");
+	if (f == NULL) {
+		fprintf(stderr, "E: Can't write samples to \'%s\'\n",
+				sampler.path);
+		ret = 1;
+	}
+
+	for (i = 0; i < sampler.size; i++) {
+		if (sampler.tbl[i].ips == NULL)
+			continue;
+		for (j = 0; (f != NULL) && (j < sampler.tbl[i].depth); j++) {
+			if (j != 0)
+				fputc(';', f);
+			prof_frame_name(vm_status, sampler.tbl[i].ips[j], f);
+		}
+		if (f != NULL)
+			fprintf(f, " %llu\n",
+				(unsigned long long)sampler.tbl[i].count);
+		free(sampler.tbl[i].ips);
+	}
+
+	if ((f != NULL) && (fclose(f) != 0))
+		ret = 1;
+	free(sampler.tbl);
+	free(sampler.buf);
+	memset(&sampler, 0, sizeof(sampler));
+
+	return ret;
+}
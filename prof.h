@@ -0,0 +1,118 @@
+#ifndef _PROF_H_
+#define _PROF_H_
+
+/*
+ * prof.h - instruction profiling
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* Local includes */
+#include "ins.h"
+
+/* System includes */
+#include <stdint.h>
+#include <stdio.h>
+#include <signal.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Cycle histogram buckets, bucket b counts executions of 2^b..2^(b+1)-1 */
+#define PROF_BUCKETS 32
+
+/* Per-opcode and per-stdcall counters */
+struct _prof {
+	uint64_t count[256];
+	uint64_t cycles[256];
+	uint64_t hist[256][PROF_BUCKETS];
+	uint64_t calls[256];
+};
+typedef struct _prof prof_t;
+
+/* Set by SIGUSR1, report is printed by next prof_record */
+extern volatile sig_atomic_t prof_dump;
+
+extern prof_t *prof_init(void);
+extern void prof_destroy(prof_t *);
+extern void prof_report(prof_t *, FILE *);
+
+/* Sampling profiler
+ *
+ * SIGPROF timer only sets prof_sample_pending, the sample itself (call
+ * stack of entry addresses, ending with address of next instruction) is
+ * taken by parse() before next instruction, so it never sees half-updated
+ * call stack. Identical stacks are counted
+ * together and written as folded stacks ("a;b;c count") by
+ * prof_sample_stop.
+ */
+#define PROF_SAMPLE_HZ 997
+
+struct _vm;
+
+extern volatile sig_atomic_t prof_sample_pending;
+
+extern int prof_sample_start(const char *, unsigned int);
+extern void prof_sample(struct _vm *);
+extern int prof_sample_stop(struct _vm *);
+
+/* Timestamp in cycles (TSC ticks), or nanoseconds where TSC isn't available */
+static inline uint64_t prof_clock(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/* Account one executed instruction which took [cycles] */
+static inline void prof_record(prof_t *p, uint8_t opcode, uint8_t arg,
+		uint64_t cycles)
+{
+	int b;
+
+	b = 63 - __builtin_clzll(cycles | 1);
+	if (b >= PROF_BUCKETS)
+		b = PROF_BUCKETS - 1;
+
+	p->count[opcode]++;
+	p->cycles[opcode] += cycles;
+	p->hist[opcode][b]++;
+	if ((opcode == IN_STDCALL) || (opcode == IN_RSTDCALL))
+		p->calls[arg]++;
+
+	if (prof_dump) {
+		prof_dump = 0;
+		prof_report(p, stderr);
+	}
+}
+
+#endif /* _PROF_H_ */
@@ -0,0 +1,237 @@
+/*
+ * reg.c - register machine instruction implementation
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* Local includes */
+#include "auvm.h"
+#include "ins.h"
+#include "auvmlib.h"
+
+/* System includes */
+#include <string.h>
+#include <arpa/inet.h>
+
+/* Value of register as typed by REG_FLAGS */
+union _reg_val {
+	uint64_t u;
+	int64_t s;
+	float f;
+	double d;
+};
+typedef union _reg_val reg_val_t;
+
+/* Size of value described by REG_FLAGS [arg], 0 if they are invalid */
+static uint32_t reg_size(uint8_t arg)
+{
+	switch (CMP_FMT(arg)) {
+		case AUVMF_UINT :
+		case AUVMF_SINT :
+			if (CMP_SIZE(arg) > sizeof(uint64_t))
+				return 0;
+			return CMP_SIZE(arg);
+		case AUVMF_FLOAT : return sizeof(float);
+		case AUVMF_DOUBLE : return sizeof(double);
+		default : return 0;
+	}
+}
+
+/* Read [sz] bytes of register, integers are extended to 64 bits */
+static void reg_get(const uint64_t *reg, uint8_t arg, uint32_t sz,
+		reg_val_t *v)
+{
+	uint32_t shift = 64 - 8 * sz;
+
+	v->u = 0;
+	memcpy(v, reg, sz);
+	if ((CMP_FMT(arg) == AUVMF_SINT) && shift)
+		v->s = (int64_t)(v->u << shift) >> shift;
+}
+
+/* d = a op b, returns nonzero for invalid operation */
+static int reg_op(uint8_t opcode, uint8_t arg, const reg_val_t *a,
+		const reg_val_t *b, reg_val_t *d)
+{
+	uint8_t fmt = CMP_FMT(arg);
+
+	if (fmt == AUVMF_FLOAT) {
+		switch (opcode) {
+			case IN_RADD : d->f = a->f + b->f; return 0;
+			case IN_RSUB : d->f = a->f - b->f; return 0;
+			case IN_RMUL : d->f = a->f * b->f; return 0;
+			case IN_RDIV : d->f = a->f / b->f; return 0;
+			default : return 1;
+		}
+	}
+
+	if (fmt == AUVMF_DOUBLE) {
+		switch (opcode) {
+			case IN_RADD : d->d = a->d + b->d; return 0;
+			case IN_RSUB : d->d = a->d - b->d; return 0;
+			case IN_RMUL : d->d = a->d * b->d; return 0;
+			case IN_RDIV : d->d = a->d / b->d; return 0;
+			default : return 1;
+		}
+	}
+
+	/* Integers, computed in 64 bits and truncated by user of result */
+	switch (opcode) {
+		case IN_RADD : d->u = a->u + b->u; break;
+		case IN_RSUB : d->u = a->u - b->u; break;
+		case IN_RMUL : d->u = a->u * b->u; break;
+		case IN_RDIV :
+		case IN_RMOD :
+			if (b->u == 0)
+				return 1;
+			if (fmt == AUVMF_UINT)
+				d->u = (opcode == IN_RDIV) ? a->u / b->u
+					: a->u % b->u;
+			else if (b->s == -1)
+				/* avoid overflow of INT64_MIN / -1 */
+				d->u = (opcode == IN_RDIV) ? -a->u : 0;
+			else
+				d->s = (opcode == IN_RDIV) ? a->s / b->s
+					: a->s % b->s;
+			break;
+		case IN_RAND : d->u = a->u & b->u; break;
+		case IN_ROR : d->u = a->u | b->u; break;
+		case IN_RXOR : d->u = a->u ^ b->u; break;
+		case IN_RSHL : d->u = a->u << (b->u & 63); break;
+		case IN_RSHR :
+			if (fmt == AUVMF_SINT)
+				d->s = a->s >> (b->u & 63);
+			else
+				d->u = a->u >> (b->u & 63);
+			break;
+		default : return 1;
+	}
+	return 0;
+}
+
+/* FLAGS_COMP_* bits for (a op b) */
+static int reg_cmp(uint8_t arg, const reg_val_t *a, const reg_val_t *b)
+{
+	switch (CMP_FMT(arg)) {
+		case AUVMF_UINT :
+			return (a->u < b->u) ? FLAGS_COMP_LT :
+				((a->u > b->u) ? FLAGS_COMP_GT : 0);
+		case AUVMF_SINT :
+			return (a->s < b->s) ? FLAGS_COMP_LT :
+				((a->s > b->s) ? FLAGS_COMP_GT : 0);
+		case AUVMF_FLOAT :
+			return (a->f < b->f) ? FLAGS_COMP_LT :
+				((a->f > b->f) ? FLAGS_COMP_GT : 0);
+		default :
+			return (a->d < b->d) ? FLAGS_COMP_LT :
+				((a->d > b->d) ? FLAGS_COMP_GT : 0);
+	}
+}
+
+
+/* INSTRUCTION IMPLEMENTATION */
+
+int in_reg(vm_t *vm_status, uint8_t opcode, uint8_t arg)
+{
+	const uint8_t *op = &vm_status->ctbl[vm_status->cip.obj]
+		.data[vm_status->cip.addr + 2];
+	uint64_t *regs = &vm_status->rf[REG_COUNT * vm_status->cs.st_count];
+	const func_sig_t *sig;
+	func_arg_t args[FUNC_ARGS_MAX];
+	func_wrap_t func;
+	reg_val_t a, b, d;
+	uint32_t sz, hi, lo;
+	void *ptr;
+
+	/* Register numbers are checked at once, REG_COUNT is power of 2 */
+	switch (opcode) {
+		case IN_RMOV :
+			vm_status->nip.addr += 2;
+			if ((op[0] | op[1]) >= REG_COUNT)
+				return 1;
+			regs[op[0]] = regs[op[1]];
+			return 0;
+		case IN_RCMP :
+			vm_status->nip.addr += 2;
+			sz = reg_size(arg);
+			if ((sz == 0) || ((op[0] | op[1]) >= REG_COUNT))
+				return 1;
+			reg_get(&regs[op[0]], arg, sz, &a);
+			reg_get(&regs[op[1]], arg, sz, &b);
+			vm_status->flags = (vm_status->flags >> 2) << 2;
+			vm_status->flags |= reg_cmp(arg, &a, &b);
+			return 0;
+		case IN_RLDI :
+			vm_status->nip.addr += sizeof(uint64_t);
+			if (arg >= REG_COUNT)
+				return 1;
+			memcpy(&hi, op, sizeof(uint32_t));
+			memcpy(&lo, op + sizeof(uint32_t), sizeof(uint32_t));
+			regs[arg] = ((uint64_t)ntohl(hi) << 32) | ntohl(lo);
+			return 0;
+		case IN_RPUSH :
+			vm_status->nip.addr++;
+			if ((arg == 0) || (arg > sizeof(uint64_t))
+				|| (op[0] >= REG_COUNT))
+				return 1;
+			return ds_pushraw(&vm_status->ds, arg, &regs[op[0]]);
+		case IN_RPOP :
+			vm_status->nip.addr++;
+			if ((arg == 0) || (arg > sizeof(uint64_t))
+				|| (op[0] >= REG_COUNT))
+				return 1;
+			ptr = ds_pop(&vm_status->ds, arg);
+			if (ptr == NULL)
+				return 1;
+			regs[op[0]] = 0;
+			memcpy(&regs[op[0]], ptr, arg);
+			return 0;
+		case IN_RSTDCALL :
+			vm_status->nip.addr++;
+			func = vm_status->func_table[arg];
+			sig = func_sig(arg);
+			if ((func == NULL) || ((sig != NULL)
+				&& (op[0] + sig->argc > REG_COUNT)))
+				return 2;
+			if (func_args(vm_status, arg, &regs[op[0]], args) != 0)
+				return 3;
+			return (*func)(vm_status, args);
+		default :
+			/* Three-address D = A op B */
+			vm_status->nip.addr += 3;
+			d.u = 0;
+			sz = reg_size(arg);
+			if ((sz == 0) || ((op[0] | op[1] | op[2]) >= REG_COUNT))
+				return 1;
+			reg_get(&regs[op[1]], arg, sz, &a);
+			reg_get(&regs[op[2]], arg, sz, &b);
+			if (reg_op(opcode, arg, &a, &b, &d) != 0)
+				return 1;
+			memcpy(&regs[op[0]], &d, sizeof(uint64_t));
+			return 0;
+	}
+}
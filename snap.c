@@ -0,0 +1,250 @@
+/*
+ * snap.c - VM snapshots
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* Local includes */
+#include "auvm.h"
+#include "snap.h"
+
+/* System includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define SNAP_ROUND(x) \
+	((((uint64_t)(x)) + LM_PAGE - 1) & ~((uint64_t)LM_PAGE - 1))
+
+/* Write snapshot of [vm_status] to [path], replacing it atomically */
+int snap_save(vm_t *vm_status, const char *path)
+{
+	snap_hdr_t hdr;
+	snap_obj_t so;
+	char *tmp, *names[256];
+	FILE *f;
+	uint64_t off;
+	int i, ret = 0;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, SNAP_MAGIC, sizeof(hdr.magic));
+	hdr.version = SNAP_VERSION;
+	hdr.hdr_size = sizeof(snap_hdr_t);
+	hdr.frame_size = sizeof(frame_t);
+	hdr.cip = vm_status->cip;
+	hdr.nip = vm_status->nip;
+	hdr.fp = vm_status->fp;
+	memcpy(hdr.lc, vm_status->lc, sizeof(hdr.lc));
+	hdr.flags = vm_status->flags & ~FLAGS_HALT;
+	hdr.obj_count = vm_status->obj_count;
+	hdr.reg_count = REG_COUNT;
+	hdr.ds_max = vm_status->ds.st_max;
+	hdr.ds_count = vm_status->ds.st_count;
+	hdr.cs_max = vm_status->cs.st_max;
+	hdr.cs_count = vm_status->cs.st_count;
+	hdr.lm_max = vm_status->lm.lm_max;
+	hdr.lm_size = vm_status->lm.lm_size;
+	hdr.arena = vm_status->arena;
+
+	/* Objects are identified by absolute path */
+	off = sizeof(snap_hdr_t);
+	for (i = 0; i < vm_status->obj_count; i++) {
+		/* Unused objects are loaded just to be identified */
+		if (obj_require(&vm_status->ctbl[i]) != 0)
+			names[i] = NULL;
+		else names[i] = realpath(vm_status->ctbl[i].filename, NULL);
+		if (names[i] == NULL) {
+			while (i--)
+				free(names[i]);
+			return 1;
+		}
+		off += sizeof(snap_obj_t) + strlen(names[i]);
+	}
+	hdr.ds_off = off;
+	hdr.cs_off = hdr.ds_off + hdr.ds_count;
+	hdr.rf_off = hdr.cs_off + sizeof(frame_t) * hdr.cs_count;
+	hdr.lm_off = SNAP_ROUND(hdr.rf_off
+			+ sizeof(uint64_t) * REG_COUNT * (hdr.cs_count + 1));
+
+	tmp = (char *)malloc(strlen(path) + sizeof(".tmp"));
+	if (tmp == NULL) {
+		ret = 2;
+		goto out;
+	}
+	sprintf(tmp, "%s.tmp", path);
+	f = fopen(tmp, "wb");
+	if (f == NULL) {
+		ret = 3;
+		goto out;
+	}
+
+	fwrite(&hdr, sizeof(hdr), 1, f);
+	for (i = 0; i < vm_status->obj_count; i++) {
+		so.hash = hash64(vm_status->ctbl[i].data, vm_status->ctbl[i].sz);
+		so.sz = vm_status->ctbl[i].sz;
+		so.name_len = strlen(names[i]);
+		fwrite(&so, sizeof(so), 1, f);
+		fwrite(names[i], 1, so.name_len, f);
+	}
+	fwrite(vm_status->ds.st_data, 1, hdr.ds_count, f);
+	fwrite(vm_status->cs.st_data, sizeof(frame_t), hdr.cs_count, f);
+	fwrite(vm_status->rf, sizeof(uint64_t) * REG_COUNT, hdr.cs_count + 1,
+			f);
+	if (hdr.lm_size != 0) {
+		fseek(f, (long)hdr.lm_off, SEEK_SET);
+		fwrite(vm_status->lm.lm_data, 1, hdr.lm_size, f);
+	}
+
+	if (ferror(f))
+		ret = 4;
+	if ((fclose(f) != 0) && (ret == 0))
+		ret = 4;
+	if ((ret == 0) && (rename(tmp, path) != 0))
+		ret = 5;
+	if (ret != 0)
+		unlink(tmp);
+
+out:
+	free(tmp);
+	for (i = 0; i < vm_status->obj_count; i++)
+		free(names[i]);
+	return ret;
+}
+
+/* Create VM from snapshot, NULL on error
+ *
+ * Modules providing stdcalls must be loaded the same way as when snapshot
+ * was taken.
+ */
+vm_t *snap_restore(const char *path)
+{
+	const snap_hdr_t *hdr;
+	const snap_obj_t *so;
+	const uint8_t *map, *p;
+	char *names[256];
+	struct stat sbuf;
+	uint64_t len;
+	vm_t *ret = NULL;
+	int fd, i, n = 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+	if ((fstat(fd, &sbuf) == -1)
+		|| ((size_t)sbuf.st_size < sizeof(snap_hdr_t))) {
+		close(fd);
+		return NULL;
+	}
+	len = sbuf.st_size;
+	map = (const uint8_t *)mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		close(fd);
+		return NULL;
+	}
+
+	hdr = (const snap_hdr_t *)map;
+	if ((memcmp(hdr->magic, SNAP_MAGIC, sizeof(hdr->magic)) != 0)
+		|| (hdr->version != SNAP_VERSION)
+		|| (hdr->hdr_size != sizeof(snap_hdr_t))
+		|| (hdr->frame_size != sizeof(frame_t))
+		|| (hdr->reg_count != REG_COUNT)
+		|| (hdr->ds_count > hdr->ds_max)
+		|| (hdr->cs_count >= hdr->cs_max)
+		|| (hdr->ds_off + hdr->ds_count > len)
+		|| (hdr->cs_off + sizeof(frame_t) * hdr->cs_count > len)
+		|| (hdr->rf_off + sizeof(uint64_t) * REG_COUNT
+			* (hdr->cs_count + 1) > len)
+		|| ((hdr->lm_size != 0)
+			&& (hdr->lm_off + hdr->lm_size > len))) {
+		fprintf(stderr, "E: \'%s\' isn't valid snapshot\n", path);
+		goto out;
+	}
+
+	/* Object identities */
+	p = map + sizeof(snap_hdr_t);
+	for (n = 0; n < hdr->obj_count; n++) {
+		so = (const snap_obj_t *)p;
+		if ((uint64_t)(p - map) + sizeof(snap_obj_t) + so->name_len
+			> hdr->ds_off)
+			goto out;
+		names[n] = strndup((const char *)(so + 1), so->name_len);
+		if (names[n] == NULL)
+			goto out;
+		p += sizeof(snap_obj_t) + so->name_len;
+	}
+
+	ret = auvm_init(hdr->ds_max, hdr->cs_max, hdr->lm_max, n, names);
+	if (ret == NULL)
+		goto out;
+
+	p = map + sizeof(snap_hdr_t);
+	for (i = 0; i < n; i++) {
+		so = (const snap_obj_t *)p;
+		if ((obj_require(&ret->ctbl[i]) != 0)
+			|| (ret->ctbl[i].sz != so->sz) || (hash64(ret->ctbl[i].data,
+				ret->ctbl[i].sz) != so->hash)) {
+			fprintf(stderr, "E: Object \'%s\' changed since "
+					"snapshot\n", names[i]);
+			auvm_destroy(ret);
+			ret = NULL;
+			goto out;
+		}
+		p += sizeof(snap_obj_t) + so->name_len;
+	}
+
+	memcpy(ret->ds.st_data, map + hdr->ds_off, hdr->ds_count);
+	ret->ds.st_count = hdr->ds_count;
+	memcpy(ret->cs.st_data, map + hdr->cs_off,
+			sizeof(frame_t) * hdr->cs_count);
+	ret->cs.st_count = hdr->cs_count;
+	memcpy(ret->rf, map + hdr->rf_off,
+			sizeof(uint64_t) * REG_COUNT * (hdr->cs_count + 1));
+	if (lm_map(&ret->lm, fd, hdr->lm_off, hdr->lm_size) != 0) {
+		auvm_destroy(ret);
+		ret = NULL;
+		goto out;
+	}
+	ret->arena = hdr->arena;
+
+	ret->cip = hdr->cip;
+	ret->nip = hdr->nip;
+	ret->fp = hdr->fp;
+	memcpy(ret->lc, hdr->lc, sizeof(ret->lc));
+	ret->flags = hdr->flags;
+
+out:
+	while (n--)
+		free(names[n]);
+	munmap((void *)map, len);
+	close(fd);
+	return ret;
+}
@@ -0,0 +1,93 @@
+#ifndef _SNAP_H_
+#define _SNAP_H_
+
+/*
+ * snap.h - VM snapshots
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* Local includes */
+#include "stack.h"
+#include "mem.h"
+
+/* System includes */
+#include <stdint.h>
+
+/* Snapshot file
+ *
+ * Header, object identities (snap_obj_t followed by name, without NUL),
+ * data stack, call stack, register files of its depths and, at page-aligned
+ * offset, linear memory. Values are in host byte order, snapshots are meant
+ * to be restored by the same build of AUVM on the same machine; hdr_size
+ * and frame_size catch layout changes. Objects aren't stored, they are
+ * loaded again and checked by size and hash.
+ */
+#define SNAP_MAGIC "AUVMSNAP"
+#define SNAP_VERSION 4
+
+struct _snap_hdr {
+	char magic[8];
+	uint32_t version;
+	uint32_t hdr_size;
+	uint32_t frame_size;
+	/* registers */
+	ip_t cip;
+	ip_t nip;
+	uint32_t fp;
+	uint32_t lc[LOOP_REGS];
+	uint8_t flags;
+	uint8_t obj_count;
+	uint16_t reg_count;
+	/* stacks and memory */
+	uint32_t ds_max;
+	uint32_t ds_count;
+	uint32_t cs_max;
+	uint32_t cs_count;
+	uint32_t lm_max;
+	uint32_t lm_size;
+	arena_t arena;
+	/* file offsets */
+	uint64_t ds_off;
+	uint64_t cs_off;
+	uint64_t rf_off;
+	uint64_t lm_off;
+};
+typedef struct _snap_hdr snap_hdr_t;
+
+struct _snap_obj {
+	uint64_t hash;
+	uint32_t sz;
+	uint32_t name_len;
+};
+typedef struct _snap_obj snap_obj_t;
+
+struct _vm;
+
+extern int snap_save(struct _vm *, const char *);
+extern struct _vm *snap_restore(const char *);
+
+#endif /* _SNAP_H_ */
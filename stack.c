@@ -40,12 +40,37 @@
 
 /* DS */
 
+/* Set up [sz] bytes of stack storage in [m] */
+static uint8_t *st_alloc(lm_t *m, uint64_t sz)
+{
+	if ((sz > UINT32_MAX) || (lm_init(m, (uint32_t)sz) != 0))
+		return NULL;
+	if (lm_grow(m, (uint32_t)sz) != 0) {
+		lm_destroy(m);
+		return NULL;
+	}
+	return m->lm_data;
+}
+
+/* Make empty storage [dst] a copy of first [sz] bytes of [src] */
+static int st_clone(lm_t *dst, lm_t *src, uint32_t sz)
+{
+	if (sz < ST_SHARE_MIN) {
+		memcpy(dst->lm_data, src->lm_data, sz);
+		return 0;
+	}
+	/* Emptied storage keeps its address, st_data stays valid */
+	if (lm_reset(dst) != 0)
+		return 1;
+	return lm_clone(dst, src);
+}
+
 int ds_init(ds_t *s, uint32_t max)
 {
 	s->st_max = max;
 	s->st_count = 0;
-	s->st_data = (uint8_t *)malloc(sizeof(uint8_t) * max);
-	if (s->st_data == NULL)
+	s->st_data = st_alloc(&s->st_mem, max);
+	if ((s->st_data == NULL) && (max != 0))
 		return 1;
 	else
 		return 0;
@@ -58,7 +83,8 @@ int ds_destroy(ds_t *s)
 	ret = s->st_count;
 	s->st_max = 0;
 	s->st_count = 0;
-	free(s->st_data);
+	lm_destroy(&s->st_mem);
+	s->st_data = NULL;
 	return ret;
 }
 
@@ -71,11 +97,20 @@ int ds_push(ds_t *s, uint32_t sz, const void *ptr)
 	} else return 1;
 }
 
+/* Push [sz] bytes in host order (unlike ds_push, no byte reversal) */
+int ds_pushraw(ds_t *s, uint32_t sz, const void *ptr)
+{
+	if ((s->st_count + sz) < s->st_max) {
+		memcpy(&(s->st_data[s->st_count]), ptr, sz);
+		s->st_count += sz;
+		return 0;
+	} else return 1;
+}
+
 void *ds_pop(ds_t *s, uint32_t sz)
 {
 	void *ret;
-	long comp = s->st_count - sz;
-	if (comp >= 0) {
+	if (sz <= s->st_count) {
 		ret = &(s->st_data[s->st_count - sz]);
 		s->st_count -= sz;
 		return ret;
@@ -85,9 +120,7 @@ void *ds_pop(ds_t *s, uint32_t sz)
 void *ds_getelem(ds_t *s, uint32_t sz, uint32_t pos)
 {
 	void *ret;
-	long comp = s->st_count - sz;
-	long poscomp = pos - sz;
-	if ((comp >= 0)	&& (pos < s->st_count) && (poscomp >= 0)) {
+	if ((uint64_t)pos + sz <= s->st_count) {
 		ret = &(s->st_data[pos]);
 		return ret;
 	} else return NULL;
@@ -115,6 +148,19 @@ void ds_show(ds_t *s)
 	printf("\nEND DATA STACK DUMP\n");
 }
 
+/* Make empty stack [dst] of same limit a copy of [src]
+ *
+ * Deep stacks share pages copy-on-write (see lm_clone).
+ */
+int ds_clone(ds_t *dst, ds_t *src)
+{
+	if ((dst->st_max != src->st_max)
+		|| (st_clone(&dst->st_mem, &src->st_mem, src->st_count) != 0))
+		return 1;
+	dst->st_count = src->st_count;
+	return 0;
+}
+
 
 /* CS */
 
@@ -122,8 +168,9 @@ int cs_init(cs_t *s, uint32_t max)
 {
 	s->st_max = max;
 	s->st_count = 0;
-	s->st_data = (ip_t *)malloc(sizeof(ip_t) * max);
-	if (s->st_data == NULL)
+	s->st_data = (frame_t *)st_alloc(&s->st_mem,
+			(uint64_t)sizeof(frame_t) * max);
+	if ((s->st_data == NULL) && (max != 0))
 		return 1;
 	else
 		return 0;
@@ -136,36 +183,34 @@ int cs_destroy(cs_t *s)
 	ret = s->st_count;
 	s->st_max = 0;
 	s->st_count = 0;
-	free(s->st_data);
+	lm_destroy(&s->st_mem);
+	s->st_data = NULL;
 	return ret;
 }
 
-int cs_push(cs_t *s, const ip_t *ptr)
+int cs_push(cs_t *s, const frame_t *ptr)
 {
 	if ((s->st_count + 1) < s->st_max) {
 		s->st_count++;
-		memcpy(&(s->st_data[s->st_count - 1]), ptr, sizeof(ip_t));
+		memcpy(&(s->st_data[s->st_count - 1]), ptr, sizeof(frame_t));
 		return 0;
 	} else return 1;
 }
 
-ip_t *cs_pop(cs_t *s)
+frame_t *cs_pop(cs_t *s)
 {
-	ip_t *ret;
-	long comp = s->st_count - 1;
-	if (comp >= 0) {
+	frame_t *ret;
+	if (s->st_count > 0) {
 		ret = &(s->st_data[s->st_count - 1]);
 		s->st_count--;
 		return ret;
 	} else return NULL;
 }
 
-ip_t *cs_getelem(cs_t *s, uint32_t pos)
+frame_t *cs_getelem(cs_t *s, uint32_t pos)
 {
-	ip_t *ret;
-	long comp = s->st_count - 1;
-	long poscomp = pos - 1;
-	if ((comp >= 0) && (pos < s->st_count) && (poscomp >= 0)) {
+	frame_t *ret;
+	if (pos < s->st_count) {
 		ret = &(s->st_data[pos]);
 		return ret;
 	} else return NULL;
@@ -180,3 +225,13 @@ uint32_t cs_limit(cs_t *s)
 {
 	return s->st_max;
 }
+
+/* Make empty stack [dst] of same limit a copy of [src], like ds_clone */
+int cs_clone(cs_t *dst, cs_t *src)
+{
+	if ((dst->st_max != src->st_max) || (st_clone(&dst->st_mem,
+			&src->st_mem, sizeof(frame_t) * src->st_count) != 0))
+		return 1;
+	dst->st_count = src->st_count;
+	return 0;
+}
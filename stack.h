@@ -32,24 +32,51 @@
 
 /* Local includes */
 #include "object.h"
+#include "mem.h"
 
 /* System includes */
 #include <stdint.h>
 #include <stddef.h>
 
-/* Data stack */
+/* Stacks with at least this many bytes in use are cloned copy-on-write,
+ * smaller ones are cheaper to copy
+ */
+#define ST_SHARE_MIN (16 * LM_PAGE)
+
+/* Data stack
+ *
+ * Storage is linear memory grown to full size at initialization (pages
+ * are allocated when touched), st_data points to it.
+ */
 struct _ds {
 	uint32_t st_count;
 	uint32_t st_max;
 	uint8_t *st_data;
+	lm_t st_mem;
 };
 typedef struct _ds ds_t;
 
-/* Call stack */
+/* Number of loop counter registers */
+#define LOOP_REGS 4
+
+/* Number of registers in register file of every call depth */
+#define REG_COUNT 32
+
+/* Call frame */
+struct _frame {
+	ip_t ret;	/* return address */
+	ip_t entry;	/* called address */
+	uint32_t fp;	/* caller's frame pointer */
+	uint32_t lc[LOOP_REGS];	/* caller's loop counters */
+};
+typedef struct _frame frame_t;
+
+/* Call stack, stored like data stack */
 struct _cs {
 	uint32_t st_count;
 	uint32_t st_max;
-	ip_t *st_data;
+	frame_t *st_data;
+	lm_t st_mem;
 };
 typedef struct _cs cs_t;
 
@@ -57,18 +84,21 @@ typedef struct _cs cs_t;
 extern int ds_init(ds_t *, uint32_t);
 extern int ds_destroy(ds_t *);
 extern int ds_push(ds_t *, uint32_t, const void *);
+extern int ds_pushraw(ds_t *, uint32_t, const void *);
 extern void *ds_pop(ds_t *, uint32_t);
 extern void *ds_getelem(ds_t *, uint32_t, uint32_t);
 extern uint32_t ds_size(ds_t *);
 extern uint32_t ds_limit(ds_t *);
 extern void ds_show(ds_t *);
+extern int ds_clone(ds_t *, ds_t *);
 
 extern int cs_init(cs_t *, uint32_t);
 extern int cs_destroy(cs_t *);
-extern int cs_push(cs_t *, const ip_t *);
-extern ip_t *cs_pop(cs_t *);
-extern ip_t *cs_getelem(cs_t *, uint32_t);
+extern int cs_push(cs_t *, const frame_t *);
+extern frame_t *cs_pop(cs_t *);
+extern frame_t *cs_getelem(cs_t *, uint32_t);
 extern uint32_t cs_size(cs_t *);
 extern uint32_t cs_limit(cs_t *);
+extern int cs_clone(cs_t *, cs_t *);
 
 #endif /* _STACK_H_ */
@@ -30,6 +30,9 @@
 /* Local includes */
 #define _AUVM_H_
 #include "../ins.h"
+#include "../mnemonic.h"
+#include "../module.h"
+#include "../lib/funcs.h"
 
 /* System includes */
 #include <stdio.h>
@@ -44,19 +47,30 @@
 void usage(const char *progname, int ec, FILE *s)
 {
 	fprintf(s, 
-		"Usage: %s [-h] file1 [file2 .. fileN]\n",
+		"Usage: %s [-h] [-l MODULE] file1 [file2 .. fileN]\n",
 		progname);
-	fprintf(s, "\n\t-h\tShow this text.\n");
+	fprintf(s, "\n\t-h\tShow this text.");
+	fprintf(s, "\n\t-l MODULE\tLoad function names from MODULE.\n");
 	exit(ec);
 }
 
-int disassemble(char *fname, char **mnem_tbl, char **fname_tbl)
+/* AUVM Library function names (wrappers are not linked in) */
+static const func_desc_t lib_funcs[FUNC_MODULE_BASE] = {
+#define FUNC(id, name, wrapper, arity, sig) \
+	[id] = { name, NULL, arity, sig },
+	AUVMLIB_FUNCS
+#undef FUNC
+};
+
+int disassemble(char *fname)
 {
 	int fd;
 	struct stat sbuf;
 	uint32_t fsize, i;
-	uint8_t opcode, oparg;
+	uint8_t opcode, oparg, map[FUNC_MAX];
 	
+	if (func_imports(fname, map) < 0)
+		return 3;
 	fd = open(fname, O_RDONLY);
 	if (fd == -1)
 		return 1;
@@ -69,19 +83,21 @@ int disassemble(char *fname, char **mnem_tbl, char **fname_tbl)
 		read(fd, &oparg, 1);
 		/* data == opcode */
 		if (opcode != IN_STDCALL)
-			printf("%s %u", mnem_tbl[opcode], oparg);
+			printf("%s %u", in_mnemonic(opcode), oparg);
 		else if (opcode == IN_STDCALL)
-			printf("%s %s", mnem_tbl[opcode], fname_tbl[oparg]);
-		if (opcode == IN_LOAD) {
+			printf("%s %s", in_mnemonic(opcode),
+				(func_desc(map[oparg]) != NULL) ?
+				func_desc(map[oparg])->name : "undefined");
+		if (in_length(opcode, oparg) > 2) {
 			uint8_t buf;
-			int j;
+			uint32_t j;
 
 			printf(", 0x");
-			for (j = 0; j < oparg; j++) {
+			for (j = 2; j < in_length(opcode, oparg); j++) {
 				read(fd, &buf, 1);
 				printf("%.2x", buf);
 			}
-			i += oparg;
+			i += in_length(opcode, oparg) - 2;
 		}
 		printf("\n");
 
@@ -94,92 +110,20 @@ int main(int argc, char **argv)
 {
 	int opt, filecount, i;
 	char **filearr;
-	char **ins_mnem;
-	char **stdcall_fnames;
-
-	ins_mnem = (char **)malloc(sizeof(char *) * 256);
-	stdcall_fnames = (char **)malloc(sizeof(char *) * 256);
-
-	if ((ins_mnem == NULL) || (stdcall_fnames == NULL))
-		return 1;
 
-	for (i = 0; i < 256; i++) {
-		ins_mnem[i] = "ndf";
-		stdcall_fnames[i] = "undefined";
-	}
+	for (i = 1; i < FUNC_MODULE_BASE; i++)
+		if (lib_funcs[i].name != NULL)
+			func_register(i, &lib_funcs[i]);
 
-	ins_mnem[IN_NOP] = "nop";
-	ins_mnem[IN_END] = "end";
-	ins_mnem[IN_DEBUG] = "debug";
-	ins_mnem[IN_STDCALL] = "stdcall";
-
-	ins_mnem[IN_LOAD] = "load";
-	ins_mnem[IN_DUP] = "dup";
-	ins_mnem[IN_GET] = "get";
-	ins_mnem[IN_DROP] = "drop";
-
-	ins_mnem[IN_ADD_UI] = "add";
-	ins_mnem[IN_ADD_SI] = "sadd";
-	ins_mnem[IN_ADD_UF] = "addf";
-	ins_mnem[IN_ADD_SF] = "saddf";
-
-	ins_mnem[IN_SUB_UI] = "sub";
-	ins_mnem[IN_SUB_SI] = "ssub";
-	ins_mnem[IN_SUB_UF] = "subf";
-	ins_mnem[IN_SUB_SF] = "ssubf";
-
-	ins_mnem[IN_MUL_UI] = "mul";
-	ins_mnem[IN_MUL_SI] = "smul";
-	ins_mnem[IN_MUL_UF] = "mulf";
-	ins_mnem[IN_MUL_SF] = "smulf";
-
-	ins_mnem[IN_DIV_UI] = "div";
-	ins_mnem[IN_DIV_SI] = "sdiv";
-	ins_mnem[IN_DIV_UF] = "divf";
-	ins_mnem[IN_DIV_SF] = "sdivf";
-
-	ins_mnem[IN_MOD_UI] = "mod";
-	ins_mnem[IN_MOD_SI] = "smod";
-
-	ins_mnem[IN_AND] = "and";
-	ins_mnem[IN_AND_L] = "land";
-	ins_mnem[IN_OR] = "or";
-	ins_mnem[IN_OR_L] = "lor";
-	ins_mnem[IN_XOR] = "xor";
-	ins_mnem[IN_XOR_L] = "lxor";
-	ins_mnem[IN_NOT] = "not";
-	ins_mnem[IN_NOT_L] = "lnot";
-	ins_mnem[IN_SHL] = "shl";
-	ins_mnem[IN_SHR] = "shr";
-	ins_mnem[IN_ROTL] = "rotl";
-	ins_mnem[IN_ROTR] = "rotr";
-
-	ins_mnem[IN_JMP] = "jmp";
-	ins_mnem[IN_JMP_L] = "ljmp";
-	ins_mnem[IN_CALL] = "call";
-	ins_mnem[IN_CALL_L] = "lcall";
-	ins_mnem[IN_RET] = "ret";
-
-	ins_mnem[IN_CMP] = "cmp";
-	ins_mnem[IN_IFEQ] = "ife";
-	ins_mnem[IN_IFNEQ] = "ifne";
-	ins_mnem[IN_IFGT] = "ifgt";
-	ins_mnem[IN_IFGE] = "ifge";
-	ins_mnem[IN_IFLT] = "iflt";
-	ins_mnem[IN_IFLE] = "ifle";
-
-
-	stdcall_fnames[1] = "print_string";
-	stdcall_fnames[2] = "print_int";
-	stdcall_fnames[3] = "print_uint";
-	stdcall_fnames[4] = "print_float";
-	stdcall_fnames[5] = "print_double";
-
-	while ((opt = getopt(argc, argv, "h")) != -1) {
+	while ((opt = getopt(argc, argv, "hl:")) != -1) {
 		switch (opt) {
 			case 'h' :
 				usage(argv[0], 0, stdout);
 				break;
+			case 'l' :
+				if (func_module_load(optarg) < 0)
+					return 1;
+				break;
 			default :
 				usage(argv[0], 2, stderr);
 		}
@@ -193,12 +137,11 @@ int main(int argc, char **argv)
 
 	for (i = 0; i < filecount; i++) {
 		printf("\n; BEGIN FILE %s\n", filearr[i]);
-		disassemble(filearr[i], ins_mnem, stdcall_fnames);
+		disassemble(filearr[i]);
 		printf("; END FILE %s\n", filearr[i]);
 	}
 
-	free(ins_mnem);
-	free(stdcall_fnames);
+	func_module_unload();
 
 	return 0;
 }
@@ -0,0 +1,451 @@
+/*
+ * tools/objlink.c - Object linker for AUVM
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+/* Local includes */
+#define _AUVM_H_
+#include "../ins.h"
+#include "../mnemonic.h"
+
+/* System includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <arpa/inet.h>
+
+/* Flags - jumps (from auvm.h) */
+#define JMP_ABS 0x01
+#define CALL_FRAME 0x02
+
+/* Input object */
+struct _input {
+	const char *name;
+	uint8_t *data;
+	uint32_t sz;
+	/* address of object in output */
+	uint32_t base;
+};
+typedef struct _input input_t;
+
+void usage(const char *progname, int ec, FILE *s)
+{
+	fprintf(s,
+		"Usage: %s [-h] -o OUTPUT file1 [file2 .. fileN]\n"
+		"       %s [-h] -d -o OUTPUT file\n", progname, progname);
+	fprintf(s, "\n\t-h\tShow this text.");
+	fprintf(s, "\n\t-d\tOnly make long jumps direct, keep object.");
+	fprintf(s, "\n\t-o OUTPUT\tWrite linked object to OUTPUT.\n");
+	fprintf(s, "\nObjects are placed one after another in OUTPUT, long "
+		"jumps and calls between\nthem become direct ones into OUTPUT."
+		" Every long or absolute jump has to\nhave static target "
+		"(LOAD 4 obj; LOAD 4 addr; JMP_L or LOAD 4 addr; JMP)\nand "
+		"no static branch may land inside of it.\n");
+	fprintf(s, "\nWith -d long jumps with static targets become direct "
+		"ones to the same\nobjects, unless object has jump without "
+		"static target or something\nbranches into the sequence.\n");
+	exit(ec);
+}
+
+static int read_file(input_t *in)
+{
+	FILE *f;
+	long sz;
+
+	f = fopen(in->name, "rb");
+	if (f == NULL)
+		return 1;
+	if ((fseek(f, 0, SEEK_END) != 0) || ((sz = ftell(f)) < 0)
+		|| (sz > UINT32_MAX) || (fseek(f, 0, SEEK_SET) != 0)) {
+		fclose(f);
+		return 1;
+	}
+	in->sz = (uint32_t)sz;
+	in->data = (uint8_t *)malloc(in->sz + 1);
+	if ((in->data == NULL)
+		|| (fread(in->data, 1, in->sz, f) != in->sz)) {
+		fclose(f);
+		return 1;
+	}
+	fclose(f);
+	return 0;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return ntohl(v);
+}
+
+/* Emit direct jump / call [opcode] to [obj] [addr] at [out] */
+static void put_direct(uint8_t *out, uint8_t opcode, uint8_t flags,
+		uint32_t obj, uint32_t addr)
+{
+	out[0] = opcode;
+	out[1] = flags;
+	memset(&out[2], 0, 3 * sizeof(uint32_t));
+	obj = htonl(obj);
+	memcpy(&out[2], &obj, sizeof(obj));
+	addr = htonl(addr);
+	memcpy(&out[2 + sizeof(uint32_t)], &addr, sizeof(addr));
+}
+
+static int is_cond(uint8_t opcode)
+{
+	return ((opcode >= IN_IFEQ) && (opcode <= IN_IFLE))
+		|| (opcode == IN_IFOV) || (opcode == IN_IFNOV);
+}
+
+/* Length of LOAD 4 v; [IF..;] {JMP,CALL} at [addr] of [in], 0 if there
+ * isn't one */
+static uint32_t static_jump(const input_t *in, uint32_t addr)
+{
+	const uint8_t *p = &in->data[addr];
+	uint32_t len;
+
+	if ((p[0] != IN_LOAD) || (p[1] != 4))
+		return 0;
+	for (len = 6; (addr + len + 1 < in->sz) && is_cond(p[len]);
+			len += 2);
+	if ((addr + len + 1 < in->sz)
+		&& ((p[len] == IN_JMP) || (p[len] == IN_CALL)))
+		return len + 2;
+	return 0;
+}
+
+/* Length of LOAD 4 obj; LOAD 4 addr; {JMP,CALL}_L at [addr] of [in], 0 if
+ * there isn't one */
+static uint32_t static_long(const input_t *in, uint32_t addr)
+{
+	const uint8_t *p = &in->data[addr];
+
+	if ((p[0] == IN_LOAD) && (p[1] == 4) && (addr + 14 <= in->sz)
+		&& (p[6] == IN_LOAD) && (p[7] == 4)
+		&& ((p[12] == IN_JMP_L) || (p[12] == IN_CALL_L)))
+		return 14;
+	return 0;
+}
+
+static void mark(uint8_t *tmap, uint32_t sz, uint32_t target)
+{
+	if (target < sz)
+		tmap[target / 8] |= 1 << (target % 8);
+}
+
+/* Mark targets of static branches of [in] in [tmap]
+ *
+ * Direct and long jumps into any object count as jumps into [in]. [dyn]
+ * is set to address of first jump without static target (or in->sz).
+ * Nonzero if [in] can't be decoded.
+ */
+static int find_targets(const input_t *in, uint8_t *tmap, uint32_t *dyn)
+{
+	const uint8_t *p;
+	uint32_t addr, len, end, i, slen, t, covered = in->sz;
+
+	*dyn = in->sz;
+	for (addr = 0; addr < in->sz; addr += len) {
+		p = &in->data[addr];
+		if ((addr + 1 >= in->sz) || (in_mnem[p[0]] == NULL)
+			|| ((len = in_length(p[0], p[1])) > in->sz - addr)) {
+			fprintf(stderr, "E: %s: can't decode instruction at "
+					"%x\n", in->name, addr);
+			return 1;
+		}
+		end = addr + len;
+
+		switch (p[0]) {
+			case IN_BEQ :
+			case IN_BNE :
+			case IN_BGT :
+			case IN_BGE :
+			case IN_BLT :
+			case IN_BLE :
+			case IN_LOOP :
+			case IN_NEXT :
+			case IN_JMPW :
+			case IN_CALLW :
+				mark(tmap, in->sz, end + get32(&p[2]));
+				break;
+			case IN_JMPI :
+				mark(tmap, in->sz, end + (int8_t)p[1]);
+				break;
+			case IN_SWITCH :
+				for (i = addr + 2; i < end; i += 4)
+					mark(tmap, in->sz, end
+						+ get32(&in->data[i]));
+				break;
+			case IN_JMP_D :
+			case IN_CALL_D :
+				mark(tmap, in->sz, get32(&p[6]));
+				break;
+			case IN_LOAD :
+				slen = static_long(in, addr);
+				if (slen != 0) {
+					mark(tmap, in->sz, get32(&p[8]));
+					covered = addr + slen - 2;
+					break;
+				}
+				slen = static_jump(in, addr);
+				if (slen == 0)
+					break;
+				covered = addr + slen - 2;
+				t = get32(&p[2]);
+				if ((p[slen - 1] & ~CALL_FRAME) != JMP_ABS)
+					t += addr + slen;
+				mark(tmap, in->sz, t);
+				break;
+			case IN_JMP :
+			case IN_CALL :
+			case IN_JMP_L :
+			case IN_CALL_L :
+				if ((addr != covered) && (*dyn == in->sz))
+					*dyn = addr;
+				break;
+		}
+	}
+	return 0;
+}
+
+/* Nonzero if some static branch lands inside [addr, addr + len) */
+static int branched_into(const uint8_t *tmap, uint32_t addr, uint32_t len)
+{
+	uint32_t i;
+
+	for (i = addr + 1; i < addr + len; i++)
+		if ((tmap[i / 8] >> (i % 8)) & 1)
+			return 1;
+	return 0;
+}
+
+/* Copy input [i] to [out], relocating jumps; nonzero on error
+ *
+ * Jump sequences are rewritten only if nothing can branch into them. With
+ * [direct] long jumps become direct ones into objects kept separate, other
+ * sequences are left alone. Otherwise [ins] are merged and everything has
+ * to be relocated.
+ */
+static int link_obj(const input_t *ins, int count, int i, uint8_t *out,
+		int direct)
+{
+	const input_t *in = &ins[i];
+	const uint8_t *p;
+	uint32_t addr, len, obj, dyn, addr_be;
+	uint8_t *tmap;
+	int ret = 1;
+
+	memcpy(out, in->data, in->sz);
+	tmap = (uint8_t *)calloc(in->sz / 8 + 1, 1);
+	if ((tmap == NULL) || (find_targets(in, tmap, &dyn) != 0))
+		goto out;
+
+	for (addr = 0; addr < in->sz; addr += len) {
+		p = &in->data[addr];
+		len = in_length(p[0], p[1]);
+
+		/* LOAD 4 obj; LOAD 4 addr; {JMP,CALL}_L -> direct */
+		if (static_long(in, addr) != 0) {
+			if ((dyn != in->sz) || branched_into(tmap, addr, 14)) {
+				if (direct)
+					continue;
+				goto unsafe;
+			}
+			obj = get32(&p[2]);
+			if (direct)
+				put_direct(&out[addr], (p[12] == IN_JMP_L) ?
+					IN_JMP_D : IN_CALL_D, p[13], obj,
+					get32(&p[8]));
+			else if (obj >= (uint32_t)count)
+				goto bad_obj;
+			else put_direct(&out[addr], (p[12] == IN_JMP_L) ?
+				IN_JMP_D : IN_CALL_D, p[13], 0,
+				ins[obj].base + get32(&p[8]));
+			len = 14;
+			continue;
+		}
+		if (direct)
+			continue;
+
+		/* {JMP,CALL}_D to any object -> to merged one */
+		if ((p[0] == IN_JMP_D) || (p[0] == IN_CALL_D)) {
+			obj = get32(&p[2]);
+			if (obj >= (uint32_t)count)
+				goto bad_obj;
+			put_direct(&out[addr], p[0], p[1], 0,
+					ins[obj].base + get32(&p[6]));
+			continue;
+		}
+
+		/* LOAD 4 addr; [IF..;] {JMP,CALL} ABS -> relocated */
+		if (((len = static_jump(in, addr)) != 0)
+			&& ((p[len - 1] & ~CALL_FRAME) == JMP_ABS)) {
+			if ((dyn != in->sz) || branched_into(tmap, addr, len))
+				goto unsafe;
+			addr_be = htonl(in->base + get32(&p[2]));
+			memcpy(&out[addr + 2], &addr_be, sizeof(addr_be));
+			continue;
+		}
+		len = in_length(p[0], p[1]);
+
+		if ((p[0] == IN_JMP_L) || (p[0] == IN_CALL_L)
+			|| (((p[0] == IN_JMP) || (p[0] == IN_CALL))
+				&& ((p[1] & ~CALL_FRAME) == JMP_ABS)))
+			goto unsafe;
+	}
+	ret = 0;
+	goto out;
+
+unsafe:
+	if (dyn != in->sz)
+		fprintf(stderr, "E: %s: jump at %x has no static target\n",
+				in->name, dyn);
+	else fprintf(stderr, "E: %s: branch into jump at %x\n",
+			in->name, addr);
+	goto out;
+bad_obj:
+	fprintf(stderr, "E: %s: jump at %x targets object %u, only %d "
+			"given\n", in->name, addr, obj, count);
+out:
+	free(tmap);
+	return ret;
+}
+
+/* Write symbols of inputs, moved by their bases, to [out].sym */
+static void link_syms(const input_t *ins, int count, const char *out)
+{
+	FILE *f, *o = NULL;
+	char *path, line[256], name[256];
+	unsigned int addr;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		path = (char *)malloc(strlen(ins[i].name) + sizeof(".sym"));
+		if (path == NULL)
+			break;
+		sprintf(path, "%s.sym", ins[i].name);
+		f = fopen(path, "r");
+		free(path);
+		if (f == NULL)
+			continue;
+
+		if (o == NULL) {
+			path = (char *)malloc(strlen(out) + sizeof(".sym"));
+			if (path != NULL) {
+				sprintf(path, "%s.sym", out);
+				o = fopen(path, "w");
+				free(path);
+			}
+			if (o == NULL) {
+				fclose(f);
+				break;
+			}
+		}
+		while (fgets(line, sizeof(line), f) != NULL)
+			if ((line[0] != ';')
+				&& (sscanf(line, "%x %255s", &addr, name) == 2))
+				fprintf(o, "%x %s\n", ins[i].base + addr, name);
+		fclose(f);
+	}
+	if (o != NULL)
+		fclose(o);
+}
+
+int main(int argc, char **argv)
+{
+	int opt, count, i, ret = 0, direct = 0;
+	const char *outname = NULL;
+	uint64_t total = 0;
+	input_t *ins;
+	uint8_t *out;
+	FILE *f;
+
+	while ((opt = getopt(argc, argv, "hdo:")) != -1) {
+		switch (opt) {
+			case 'h' :
+				usage(argv[0], 0, stdout);
+				break;
+			case 'd' :
+				direct = 1;
+				break;
+			case 'o' :
+				outname = optarg;
+				break;
+			default :
+				usage(argv[0], 2, stderr);
+		}
+	}
+
+	if ((optind >= argc) || (outname == NULL)
+		|| (direct && (optind + 1 != argc)))
+		usage(argv[0], 3, stderr);
+
+	count = argc - optind;
+	ins = (input_t *)calloc(count, sizeof(input_t));
+	if (ins == NULL)
+		return 1;
+
+	for (i = 0; i < count; i++) {
+		ins[i].name = argv[optind + i];
+		if (read_file(&ins[i]) != 0) {
+			fprintf(stderr, "E: Can't read \'%s\'\n", ins[i].name);
+			return 1;
+		}
+		ins[i].base = (uint32_t)total;
+		total += ins[i].sz;
+		if (total > UINT32_MAX) {
+			fprintf(stderr, "E: Merged object is too big\n");
+			return 1;
+		}
+	}
+
+	out = (uint8_t *)malloc(total + 1);
+	if (out == NULL)
+		return 1;
+	for (i = 0; (i < count) && (ret == 0); i++)
+		ret = link_obj(ins, count, i, &out[ins[i].base], direct);
+	if (ret != 0)
+		return 4;
+
+	f = fopen(outname, "wb");
+	if ((f == NULL) || (fwrite(out, 1, total, f) != total)
+		|| (fclose(f) != 0)) {
+		fprintf(stderr, "E: Can't write \'%s\'\n", outname);
+		return 5;
+	}
+	link_syms(ins, count, outname);
+
+	for (i = 0; i < count; i++)
+		free(ins[i].data);
+	free(ins);
+	free(out);
+
+	return 0;
+}
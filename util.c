@@ -32,6 +32,7 @@
 
 /* System includes */
 #include <stddef.h>
+#include <string.h>
 
 /* Reversed memory copy function */
 void *revmemcpy(void *dst, const void *src, uint32_t n)
@@ -42,3 +43,39 @@ void *revmemcpy(void *dst, const void *src, uint32_t n)
 		*dp-- = *sp++;
 	return dst;
 }
+
+/* Reverse memory in place, 8 bytes at a time from both ends */
+void revmem(void *ptr, uint32_t n)
+{
+	uint8_t *p = (uint8_t *)ptr;
+	uint8_t *q = p + n;
+	uint64_t x, y;
+	uint8_t t;
+
+	while (q - p >= 16) {
+		q -= 8;
+		memcpy(&x, p, sizeof(uint64_t));
+		memcpy(&y, q, sizeof(uint64_t));
+		x = __builtin_bswap64(x);
+		y = __builtin_bswap64(y);
+		memcpy(p, &y, sizeof(uint64_t));
+		memcpy(q, &x, sizeof(uint64_t));
+		p += 8;
+	}
+	while (q - p > 1) {
+		t = *p;
+		*p++ = *--q;
+		*q = t;
+	}
+}
+
+/* 64-bit FNV-1a hash */
+uint64_t hash64(const void *ptr, size_t n)
+{
+	const uint8_t *p = (const uint8_t *)ptr;
+	uint64_t h = 14695981039346656037ULL;
+
+	while (n--)
+		h = (h ^ *p++) * 1099511628211ULL;
+	return h;
+}
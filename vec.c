@@ -0,0 +1,720 @@
+/*
+ * vec.c - vector instruction implementation
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* Local includes */
+#include "auvm.h"
+#include "ins.h"
+
+/* System includes */
+#include <string.h>
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VEC_X86
+#include <immintrin.h>
+#define VEC_SSE2 __attribute__((target("sse2")))
+#define VEC_AVX2 __attribute__((target("avx2")))
+#endif
+
+/* Vector kernel: d = a op b over n bytes (horizontal ops ignore b) */
+typedef void (*vec_fn_t)(uint8_t *, const uint8_t *, const uint8_t *,
+		uint32_t);
+
+#define VEC_OPS (IN_VHMAX - IN_VADD + 1)
+#define VEC_TYPES (VEC_F64 + 1)
+
+/* Lane size for each VEC_* type */
+static const uint8_t vec_lane[VEC_TYPES] = { 0, 1, 2, 4, 4, 8 };
+
+/* Kernels in use, [0] for VEC_128 and [1] for VEC_256 */
+static vec_fn_t vec_tbl[2][VEC_OPS][VEC_TYPES];
+
+/* Reduction kernels (vec_fn_t of n bytes, d gets single element), by
+ * operation and VEC_F32 / VEC_F64 */
+#define RED_OPS (IN_FMAX - IN_FDOT + 1)
+#define RED_TYPES 2
+
+/* Kernels in use for reductions without RED_ORD */
+static vec_fn_t red_tbl[RED_OPS][RED_TYPES];
+
+
+/* SCALAR KERNELS */
+
+#define VEC_BINOP(name, type, expr) \
+static void name(uint8_t *d, const uint8_t *a, const uint8_t *b, \
+		uint32_t n) \
+{ \
+	type x, y, z; \
+	uint32_t i; \
+	for (i = 0; i < n; i += sizeof(type)) { \
+		memcpy(&x, a + i, sizeof(type)); \
+		memcpy(&y, b + i, sizeof(type)); \
+		z = (expr); \
+		memcpy(d + i, &z, sizeof(type)); \
+	} \
+}
+
+#define VEC_CMPOP(name, type, mtype, expr) \
+static void name(uint8_t *d, const uint8_t *a, const uint8_t *b, \
+		uint32_t n) \
+{ \
+	type x, y; \
+	mtype z; \
+	uint32_t i; \
+	for (i = 0; i < n; i += sizeof(type)) { \
+		memcpy(&x, a + i, sizeof(type)); \
+		memcpy(&y, b + i, sizeof(type)); \
+		z = (expr) ? (mtype)~0 : 0; \
+		memcpy(d + i, &z, sizeof(type)); \
+	} \
+}
+
+#define VEC_HOP(name, type, expr) \
+static void name(uint8_t *d, const uint8_t *a, \
+		const uint8_t *UNUSED(b), uint32_t n) \
+{ \
+	type x, y; \
+	uint32_t i; \
+	memcpy(&x, a, sizeof(type)); \
+	for (i = sizeof(type); i < n; i += sizeof(type)) { \
+		memcpy(&y, a + i, sizeof(type)); \
+		x = (expr); \
+	} \
+	memcpy(d, &x, sizeof(type)); \
+}
+
+#define VEC_SCALAR(sfx, type, mtype) \
+	VEC_BINOP(vec_add_##sfx, type, x + y) \
+	VEC_BINOP(vec_sub_##sfx, type, x - y) \
+	VEC_BINOP(vec_mul_##sfx, type, x * y) \
+	VEC_BINOP(vec_min_##sfx, type, (x < y) ? x : y) \
+	VEC_BINOP(vec_max_##sfx, type, (x > y) ? x : y) \
+	VEC_CMPOP(vec_cmpeq_##sfx, type, mtype, x == y) \
+	VEC_CMPOP(vec_cmpgt_##sfx, type, mtype, x > y) \
+	VEC_HOP(vec_sum_##sfx, type, x + y) \
+	VEC_HOP(vec_hmin_##sfx, type, (y < x) ? y : x) \
+	VEC_HOP(vec_hmax_##sfx, type, (y > x) ? y : x)
+
+VEC_SCALAR(u8, uint8_t, uint8_t)
+VEC_SCALAR(u16, uint16_t, uint16_t)
+VEC_SCALAR(u32, uint32_t, uint32_t)
+VEC_SCALAR(f32, float, uint32_t)
+VEC_SCALAR(f64, double, uint64_t)
+
+/* Reductions in order of addresses, used for RED_ORD */
+#define RED_SEQ(name, type, x0, expr) \
+static void name(uint8_t *d, const uint8_t *a, \
+		const uint8_t *UNUSED(b), uint32_t n) \
+{ \
+	type x = (x0), y; \
+	uint32_t i; \
+	for (i = 0; i < n; i += sizeof(type)) { \
+		memcpy(&y, a + i, sizeof(type)); \
+		x = (expr); \
+	} \
+	memcpy(d, &x, sizeof(type)); \
+}
+
+#define RED_SEQ_DOT(name, type) \
+static void name(uint8_t *d, const uint8_t *a, const uint8_t *b, \
+		uint32_t n) \
+{ \
+	type x = 0, y, z; \
+	uint32_t i; \
+	for (i = 0; i < n; i += sizeof(type)) { \
+		memcpy(&y, a + i, sizeof(type)); \
+		memcpy(&z, b + i, sizeof(type)); \
+		x += y * z; \
+	} \
+	memcpy(d, &x, sizeof(type)); \
+}
+
+#define RED_SCALAR(sfx, type) \
+	RED_SEQ_DOT(seq_rdot_##sfx, type) \
+	RED_SEQ(seq_rsum_##sfx, type, 0, x + y) \
+	RED_SEQ(seq_rmin_##sfx, type, INFINITY, (y < x) ? y : x) \
+	RED_SEQ(seq_rmax_##sfx, type, -INFINITY, (y > x) ? y : x)
+
+RED_SCALAR(f32, float)
+RED_SCALAR(f64, double)
+
+#define RED_ROW(isa, op) { &isa##_r##op##_f32, &isa##_r##op##_f64 }
+
+static const vec_fn_t red_seq[RED_OPS][RED_TYPES] = {
+	[IN_FDOT - IN_FDOT] = RED_ROW(seq, dot),
+	[IN_FSUM - IN_FDOT] = RED_ROW(seq, sum),
+	[IN_FMIN - IN_FDOT] = RED_ROW(seq, min),
+	[IN_FMAX - IN_FDOT] = RED_ROW(seq, max),
+};
+
+#define VEC_ROW(op) \
+	{ NULL, &vec_##op##_u8, &vec_##op##_u16, &vec_##op##_u32, \
+		&vec_##op##_f32, &vec_##op##_f64 }
+
+static const vec_fn_t vec_scalar[VEC_OPS][VEC_TYPES] = {
+	[IN_VADD - IN_VADD] = VEC_ROW(add),
+	[IN_VSUB - IN_VADD] = VEC_ROW(sub),
+	[IN_VMUL - IN_VADD] = VEC_ROW(mul),
+	[IN_VMIN - IN_VADD] = VEC_ROW(min),
+	[IN_VMAX - IN_VADD] = VEC_ROW(max),
+	[IN_VCMPEQ - IN_VADD] = VEC_ROW(cmpeq),
+	[IN_VCMPGT - IN_VADD] = VEC_ROW(cmpgt),
+	[IN_VSUM - IN_VADD] = VEC_ROW(sum),
+	[IN_VHMIN - IN_VADD] = VEC_ROW(hmin),
+	[IN_VHMAX - IN_VADD] = VEC_ROW(hmax),
+};
+
+
+#ifdef VEC_X86
+
+/* SSE2 KERNELS (16 bytes per step) */
+
+#define VEC_SSE2_I(name, fn) \
+static VEC_SSE2 void name(uint8_t *d, const uint8_t *a, const uint8_t *b, \
+		uint32_t n) \
+{ \
+	uint32_t i; \
+	for (i = 0; i < n; i += 16) \
+		_mm_storeu_si128((__m128i *)(d + i), fn( \
+			_mm_loadu_si128((const __m128i *)(a + i)), \
+			_mm_loadu_si128((const __m128i *)(b + i)))); \
+}
+
+#define VEC_SSE2_PS(name, fn) \
+static VEC_SSE2 void name(uint8_t *d, const uint8_t *a, const uint8_t *b, \
+		uint32_t n) \
+{ \
+	uint32_t i; \
+	for (i = 0; i < n; i += 16) \
+		_mm_storeu_ps((float *)(d + i), fn( \
+			_mm_loadu_ps((const float *)(a + i)), \
+			_mm_loadu_ps((const float *)(b + i)))); \
+}
+
+#define VEC_SSE2_PD(name, fn) \
+static VEC_SSE2 void name(uint8_t *d, const uint8_t *a, const uint8_t *b, \
+		uint32_t n) \
+{ \
+	uint32_t i; \
+	for (i = 0; i < n; i += 16) \
+		_mm_storeu_pd((double *)(d + i), fn( \
+			_mm_loadu_pd((const double *)(a + i)), \
+			_mm_loadu_pd((const double *)(b + i)))); \
+}
+
+/* Operations SSE2 lacks, emulated with sign-bit flipping and shuffles */
+static inline VEC_SSE2 __m128i sse2_mullo_epi8(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mullo_epi16(a, b);
+	__m128i odd = _mm_mullo_epi16(_mm_srli_epi16(a, 8),
+			_mm_srli_epi16(b, 8));
+	return _mm_or_si128(_mm_slli_epi16(odd, 8),
+			_mm_and_si128(even, _mm_set1_epi16(0xff)));
+}
+
+static inline VEC_SSE2 __m128i sse2_mullo_epi32(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4),
+			_mm_srli_si128(b, 4));
+	return _mm_unpacklo_epi32(
+			_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+			_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline VEC_SSE2 __m128i sse2_cmpgt_epu8(__m128i a, __m128i b)
+{
+	__m128i s = _mm_set1_epi8((char)0x80);
+	return _mm_cmpgt_epi8(_mm_xor_si128(a, s), _mm_xor_si128(b, s));
+}
+
+static inline VEC_SSE2 __m128i sse2_cmpgt_epu16(__m128i a, __m128i b)
+{
+	__m128i s = _mm_set1_epi16((short)0x8000);
+	return _mm_cmpgt_epi16(_mm_xor_si128(a, s), _mm_xor_si128(b, s));
+}
+
+static inline VEC_SSE2 __m128i sse2_cmpgt_epu32(__m128i a, __m128i b)
+{
+	__m128i s = _mm_set1_epi32((int)0x80000000);
+	return _mm_cmpgt_epi32(_mm_xor_si128(a, s), _mm_xor_si128(b, s));
+}
+
+static inline VEC_SSE2 __m128i sse2_min_epu16(__m128i a, __m128i b)
+{
+	__m128i s = _mm_set1_epi16((short)0x8000);
+	return _mm_xor_si128(s, _mm_min_epi16(_mm_xor_si128(a, s),
+				_mm_xor_si128(b, s)));
+}
+
+static inline VEC_SSE2 __m128i sse2_max_epu16(__m128i a, __m128i b)
+{
+	__m128i s = _mm_set1_epi16((short)0x8000);
+	return _mm_xor_si128(s, _mm_max_epi16(_mm_xor_si128(a, s),
+				_mm_xor_si128(b, s)));
+}
+
+static inline VEC_SSE2 __m128i sse2_min_epu32(__m128i a, __m128i b)
+{
+	__m128i gt = sse2_cmpgt_epu32(a, b);
+	return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+}
+
+static inline VEC_SSE2 __m128i sse2_max_epu32(__m128i a, __m128i b)
+{
+	__m128i gt = sse2_cmpgt_epu32(a, b);
+	return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+
+VEC_SSE2_I(sse2_add_u8, _mm_add_epi8)
+VEC_SSE2_I(sse2_add_u16, _mm_add_epi16)
+VEC_SSE2_I(sse2_add_u32, _mm_add_epi32)
+VEC_SSE2_I(sse2_sub_u8, _mm_sub_epi8)
+VEC_SSE2_I(sse2_sub_u16, _mm_sub_epi16)
+VEC_SSE2_I(sse2_sub_u32, _mm_sub_epi32)
+VEC_SSE2_I(sse2_mul_u8, sse2_mullo_epi8)
+VEC_SSE2_I(sse2_mul_u16, _mm_mullo_epi16)
+VEC_SSE2_I(sse2_mul_u32, sse2_mullo_epi32)
+VEC_SSE2_I(sse2_min_u8, _mm_min_epu8)
+VEC_SSE2_I(sse2_min_u16, sse2_min_epu16)
+VEC_SSE2_I(sse2_min_u32, sse2_min_epu32)
+VEC_SSE2_I(sse2_max_u8, _mm_max_epu8)
+VEC_SSE2_I(sse2_max_u16, sse2_max_epu16)
+VEC_SSE2_I(sse2_max_u32, sse2_max_epu32)
+VEC_SSE2_I(sse2_cmpeq_u8, _mm_cmpeq_epi8)
+VEC_SSE2_I(sse2_cmpeq_u16, _mm_cmpeq_epi16)
+VEC_SSE2_I(sse2_cmpeq_u32, _mm_cmpeq_epi32)
+VEC_SSE2_I(sse2_cmpgt_u8, sse2_cmpgt_epu8)
+VEC_SSE2_I(sse2_cmpgt_u16, sse2_cmpgt_epu16)
+VEC_SSE2_I(sse2_cmpgt_u32, sse2_cmpgt_epu32)
+
+VEC_SSE2_PS(sse2_add_f32, _mm_add_ps)
+VEC_SSE2_PS(sse2_sub_f32, _mm_sub_ps)
+VEC_SSE2_PS(sse2_mul_f32, _mm_mul_ps)
+VEC_SSE2_PS(sse2_min_f32, _mm_min_ps)
+VEC_SSE2_PS(sse2_max_f32, _mm_max_ps)
+VEC_SSE2_PS(sse2_cmpeq_f32, _mm_cmpeq_ps)
+VEC_SSE2_PS(sse2_cmpgt_f32, _mm_cmpgt_ps)
+
+VEC_SSE2_PD(sse2_add_f64, _mm_add_pd)
+VEC_SSE2_PD(sse2_sub_f64, _mm_sub_pd)
+VEC_SSE2_PD(sse2_mul_f64, _mm_mul_pd)
+VEC_SSE2_PD(sse2_min_f64, _mm_min_pd)
+VEC_SSE2_PD(sse2_max_f64, _mm_max_pd)
+VEC_SSE2_PD(sse2_cmpeq_f64, _mm_cmpeq_pd)
+VEC_SSE2_PD(sse2_cmpgt_f64, _mm_cmpgt_pd)
+
+
+/* AVX2 KERNELS (32 bytes per step, used for VEC_256 only) */
+
+#define VEC_AVX2_I(name, fn) \
+static VEC_AVX2 void name(uint8_t *d, const uint8_t *a, const uint8_t *b, \
+		uint32_t n) \
+{ \
+	uint32_t i; \
+	for (i = 0; i < n; i += 32) \
+		_mm256_storeu_si256((__m256i *)(d + i), fn( \
+			_mm256_loadu_si256((const __m256i *)(a + i)), \
+			_mm256_loadu_si256((const __m256i *)(b + i)))); \
+}
+
+#define VEC_AVX2_PS(name, fn) \
+static VEC_AVX2 void name(uint8_t *d, const uint8_t *a, const uint8_t *b, \
+		uint32_t n) \
+{ \
+	uint32_t i; \
+	for (i = 0; i < n; i += 32) \
+		_mm256_storeu_ps((float *)(d + i), fn( \
+			_mm256_loadu_ps((const float *)(a + i)), \
+			_mm256_loadu_ps((const float *)(b + i)))); \
+}
+
+#define VEC_AVX2_PD(name, fn) \
+static VEC_AVX2 void name(uint8_t *d, const uint8_t *a, const uint8_t *b, \
+		uint32_t n) \
+{ \
+	uint32_t i; \
+	for (i = 0; i < n; i += 32) \
+		_mm256_storeu_pd((double *)(d + i), fn( \
+			_mm256_loadu_pd((const double *)(a + i)), \
+			_mm256_loadu_pd((const double *)(b + i)))); \
+}
+
+static inline VEC_AVX2 __m256i avx2_mullo_epi8(__m256i a, __m256i b)
+{
+	__m256i even = _mm256_mullo_epi16(a, b);
+	__m256i odd = _mm256_mullo_epi16(_mm256_srli_epi16(a, 8),
+			_mm256_srli_epi16(b, 8));
+	return _mm256_or_si256(_mm256_slli_epi16(odd, 8),
+			_mm256_and_si256(even, _mm256_set1_epi16(0xff)));
+}
+
+static inline VEC_AVX2 __m256i avx2_cmpgt_epu8(__m256i a, __m256i b)
+{
+	__m256i s = _mm256_set1_epi8((char)0x80);
+	return _mm256_cmpgt_epi8(_mm256_xor_si256(a, s),
+			_mm256_xor_si256(b, s));
+}
+
+static inline VEC_AVX2 __m256i avx2_cmpgt_epu16(__m256i a, __m256i b)
+{
+	__m256i s = _mm256_set1_epi16((short)0x8000);
+	return _mm256_cmpgt_epi16(_mm256_xor_si256(a, s),
+			_mm256_xor_si256(b, s));
+}
+
+static inline VEC_AVX2 __m256i avx2_cmpgt_epu32(__m256i a, __m256i b)
+{
+	__m256i s = _mm256_set1_epi32((int)0x80000000);
+	return _mm256_cmpgt_epi32(_mm256_xor_si256(a, s),
+			_mm256_xor_si256(b, s));
+}
+
+static inline VEC_AVX2 __m256 avx2_cmpeq_ps(__m256 a, __m256 b)
+{
+	return _mm256_cmp_ps(a, b, _CMP_EQ_OQ);
+}
+
+static inline VEC_AVX2 __m256 avx2_cmpgt_ps(__m256 a, __m256 b)
+{
+	return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+}
+
+static inline VEC_AVX2 __m256d avx2_cmpeq_pd(__m256d a, __m256d b)
+{
+	return _mm256_cmp_pd(a, b, _CMP_EQ_OQ);
+}
+
+static inline VEC_AVX2 __m256d avx2_cmpgt_pd(__m256d a, __m256d b)
+{
+	return _mm256_cmp_pd(a, b, _CMP_GT_OQ);
+}
+
+VEC_AVX2_I(avx2_add_u8, _mm256_add_epi8)
+VEC_AVX2_I(avx2_add_u16, _mm256_add_epi16)
+VEC_AVX2_I(avx2_add_u32, _mm256_add_epi32)
+VEC_AVX2_I(avx2_sub_u8, _mm256_sub_epi8)
+VEC_AVX2_I(avx2_sub_u16, _mm256_sub_epi16)
+VEC_AVX2_I(avx2_sub_u32, _mm256_sub_epi32)
+VEC_AVX2_I(avx2_mul_u8, avx2_mullo_epi8)
+VEC_AVX2_I(avx2_mul_u16, _mm256_mullo_epi16)
+VEC_AVX2_I(avx2_mul_u32, _mm256_mullo_epi32)
+VEC_AVX2_I(avx2_min_u8, _mm256_min_epu8)
+VEC_AVX2_I(avx2_min_u16, _mm256_min_epu16)
+VEC_AVX2_I(avx2_min_u32, _mm256_min_epu32)
+VEC_AVX2_I(avx2_max_u8, _mm256_max_epu8)
+VEC_AVX2_I(avx2_max_u16, _mm256_max_epu16)
+VEC_AVX2_I(avx2_max_u32, _mm256_max_epu32)
+VEC_AVX2_I(avx2_cmpeq_u8, _mm256_cmpeq_epi8)
+VEC_AVX2_I(avx2_cmpeq_u16, _mm256_cmpeq_epi16)
+VEC_AVX2_I(avx2_cmpeq_u32, _mm256_cmpeq_epi32)
+VEC_AVX2_I(avx2_cmpgt_u8, avx2_cmpgt_epu8)
+VEC_AVX2_I(avx2_cmpgt_u16, avx2_cmpgt_epu16)
+VEC_AVX2_I(avx2_cmpgt_u32, avx2_cmpgt_epu32)
+
+VEC_AVX2_PS(avx2_add_f32, _mm256_add_ps)
+VEC_AVX2_PS(avx2_sub_f32, _mm256_sub_ps)
+VEC_AVX2_PS(avx2_mul_f32, _mm256_mul_ps)
+VEC_AVX2_PS(avx2_min_f32, _mm256_min_ps)
+VEC_AVX2_PS(avx2_max_f32, _mm256_max_ps)
+VEC_AVX2_PS(avx2_cmpeq_f32, avx2_cmpeq_ps)
+VEC_AVX2_PS(avx2_cmpgt_f32, avx2_cmpgt_ps)
+
+VEC_AVX2_PD(avx2_add_f64, _mm256_add_pd)
+VEC_AVX2_PD(avx2_sub_f64, _mm256_sub_pd)
+VEC_AVX2_PD(avx2_mul_f64, _mm256_mul_pd)
+VEC_AVX2_PD(avx2_min_f64, _mm256_min_pd)
+VEC_AVX2_PD(avx2_max_f64, _mm256_max_pd)
+VEC_AVX2_PD(avx2_cmpeq_f64, avx2_cmpeq_pd)
+VEC_AVX2_PD(avx2_cmpgt_f64, avx2_cmpgt_pd)
+
+/* Horizontal operations have no SIMD variants, vectors are too short */
+#define VEC_SIMD_ROW(isa, op) \
+	{ NULL, &isa##_##op##_u8, &isa##_##op##_u16, &isa##_##op##_u32, \
+		&isa##_##op##_f32, &isa##_##op##_f64 }
+
+static const vec_fn_t vec_sse2[VEC_OPS][VEC_TYPES] = {
+	[IN_VADD - IN_VADD] = VEC_SIMD_ROW(sse2, add),
+	[IN_VSUB - IN_VADD] = VEC_SIMD_ROW(sse2, sub),
+	[IN_VMUL - IN_VADD] = VEC_SIMD_ROW(sse2, mul),
+	[IN_VMIN - IN_VADD] = VEC_SIMD_ROW(sse2, min),
+	[IN_VMAX - IN_VADD] = VEC_SIMD_ROW(sse2, max),
+	[IN_VCMPEQ - IN_VADD] = VEC_SIMD_ROW(sse2, cmpeq),
+	[IN_VCMPGT - IN_VADD] = VEC_SIMD_ROW(sse2, cmpgt),
+};
+
+static const vec_fn_t vec_avx2[VEC_OPS][VEC_TYPES] = {
+	[IN_VADD - IN_VADD] = VEC_SIMD_ROW(avx2, add),
+	[IN_VSUB - IN_VADD] = VEC_SIMD_ROW(avx2, sub),
+	[IN_VMUL - IN_VADD] = VEC_SIMD_ROW(avx2, mul),
+	[IN_VMIN - IN_VADD] = VEC_SIMD_ROW(avx2, min),
+	[IN_VMAX - IN_VADD] = VEC_SIMD_ROW(avx2, max),
+	[IN_VCMPEQ - IN_VADD] = VEC_SIMD_ROW(avx2, cmpeq),
+	[IN_VCMPGT - IN_VADD] = VEC_SIMD_ROW(avx2, cmpgt),
+};
+
+
+/* SIMD REDUCTIONS
+ *
+ * 4 accumulators of W bytes are updated by vop(acc, a, b), their lanes and
+ * remaining elements are then combined in order by [expr] of x (result so
+ * far) and y (next value). Kernels of FDOT get b, the others only a.
+ *
+ * SIMD min / max return their second operand if either is NaN, so element
+ * goes first and accumulator survives NaN like x in [expr].
+ */
+
+#define RED_SIMD(name, attr, type, V, W, dot, x0, init, vop, expr) \
+static attr void name(uint8_t *d, const uint8_t *a, const uint8_t *b, \
+		uint32_t n) \
+{ \
+	V s[4] = { init, init, init, init }; \
+	type lane[4 * (W) / sizeof(type)], x = (x0), y, z; \
+	uint32_t i, j; \
+	for (i = 0; i + 4 * (W) <= n; i += 4 * (W)) \
+		for (j = 0; j < 4; j++) \
+			s[j] = vop(s[j], a + i + j * (W), b + i + j * (W)); \
+	memcpy(lane, s, sizeof(lane)); \
+	for (j = 0; j < 4 * (W) / sizeof(type); j++) { \
+		y = lane[j]; \
+		x = (expr); \
+	} \
+	for (; i < n; i += sizeof(type)) { \
+		memcpy(&y, a + i, sizeof(type)); \
+		if (dot) { \
+			memcpy(&z, b + i, sizeof(type)); \
+			y *= z; \
+		} \
+		x = (expr); \
+	} \
+	memcpy(d, &x, sizeof(type)); \
+}
+
+#define RED_VOPS(isa, attr, sfx, V, type, load, add, mul, min, max) \
+static inline attr V isa##_vdot_##sfx(V s, const uint8_t *a, \
+		const uint8_t *b) \
+{ \
+	return add(s, mul(load((const type *)a), load((const type *)b))); \
+} \
+static inline attr V isa##_vsum_##sfx(V s, const uint8_t *a, \
+		const uint8_t *UNUSED(b)) \
+{ \
+	return add(s, load((const type *)a)); \
+} \
+static inline attr V isa##_vmin_##sfx(V s, const uint8_t *a, \
+		const uint8_t *UNUSED(b)) \
+{ \
+	return min(load((const type *)a), s); \
+} \
+static inline attr V isa##_vmax_##sfx(V s, const uint8_t *a, \
+		const uint8_t *UNUSED(b)) \
+{ \
+	return max(load((const type *)a), s); \
+}
+
+#define RED_KERNELS(isa, attr, sfx, vsfx, type, V, set1) \
+	RED_SIMD(isa##_rdot_##sfx, attr, type, V, sizeof(V), 1, 0, \
+		set1(0), isa##_vdot_##vsfx, x + y) \
+	RED_SIMD(isa##_rsum_##sfx, attr, type, V, sizeof(V), 0, 0, \
+		set1(0), isa##_vsum_##vsfx, x + y) \
+	RED_SIMD(isa##_rmin_##sfx, attr, type, V, sizeof(V), 0, INFINITY, \
+		set1(INFINITY), isa##_vmin_##vsfx, (y < x) ? y : x) \
+	RED_SIMD(isa##_rmax_##sfx, attr, type, V, sizeof(V), 0, -INFINITY, \
+		set1(-INFINITY), isa##_vmax_##vsfx, (y > x) ? y : x)
+
+RED_VOPS(sse2, VEC_SSE2, ps, __m128, float, _mm_loadu_ps, _mm_add_ps,
+		_mm_mul_ps, _mm_min_ps, _mm_max_ps)
+RED_VOPS(sse2, VEC_SSE2, pd, __m128d, double, _mm_loadu_pd, _mm_add_pd,
+		_mm_mul_pd, _mm_min_pd, _mm_max_pd)
+RED_VOPS(avx2, VEC_AVX2, ps, __m256, float, _mm256_loadu_ps, _mm256_add_ps,
+		_mm256_mul_ps, _mm256_min_ps, _mm256_max_ps)
+RED_VOPS(avx2, VEC_AVX2, pd, __m256d, double, _mm256_loadu_pd,
+		_mm256_add_pd, _mm256_mul_pd, _mm256_min_pd, _mm256_max_pd)
+
+RED_KERNELS(sse2, VEC_SSE2, f32, ps, float, __m128, _mm_set1_ps)
+RED_KERNELS(sse2, VEC_SSE2, f64, pd, double, __m128d, _mm_set1_pd)
+RED_KERNELS(avx2, VEC_AVX2, f32, ps, float, __m256, _mm256_set1_ps)
+RED_KERNELS(avx2, VEC_AVX2, f64, pd, double, __m256d, _mm256_set1_pd)
+
+static const vec_fn_t red_sse2[RED_OPS][RED_TYPES] = {
+	[IN_FDOT - IN_FDOT] = RED_ROW(sse2, dot),
+	[IN_FSUM - IN_FDOT] = RED_ROW(sse2, sum),
+	[IN_FMIN - IN_FDOT] = RED_ROW(sse2, min),
+	[IN_FMAX - IN_FDOT] = RED_ROW(sse2, max),
+};
+
+static const vec_fn_t red_avx2[RED_OPS][RED_TYPES] = {
+	[IN_FDOT - IN_FDOT] = RED_ROW(avx2, dot),
+	[IN_FSUM - IN_FDOT] = RED_ROW(avx2, sum),
+	[IN_FMIN - IN_FDOT] = RED_ROW(avx2, min),
+	[IN_FMAX - IN_FDOT] = RED_ROW(avx2, max),
+};
+
+#endif /* VEC_X86 */
+
+/* Overlay non-NULL kernels of src over dst */
+static void vec_overlay(vec_fn_t dst[VEC_OPS][VEC_TYPES],
+		const vec_fn_t src[VEC_OPS][VEC_TYPES])
+{
+	int i, j;
+
+	for (i = 0; i < VEC_OPS; i++)
+		for (j = 0; j < VEC_TYPES; j++)
+			if (src[i][j] != NULL)
+				dst[i][j] = src[i][j];
+}
+
+/* Select best kernels for CPU we are running on */
+void vec_init(void)
+{
+	vec_overlay(vec_tbl[0], vec_scalar);
+	vec_overlay(vec_tbl[1], vec_scalar);
+	memcpy(red_tbl, red_seq, sizeof(red_tbl));
+
+#ifdef VEC_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2")) {
+		vec_overlay(vec_tbl[0], vec_sse2);
+		vec_overlay(vec_tbl[1], vec_sse2);
+		memcpy(red_tbl, red_sse2, sizeof(red_tbl));
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		vec_overlay(vec_tbl[1], vec_avx2);
+		memcpy(red_tbl, red_avx2, sizeof(red_tbl));
+	}
+#endif
+}
+
+
+/* INSTRUCTION IMPLEMENTATION */
+
+int in_vec(vm_t *vm_status, uint8_t opcode, uint8_t arg)
+{
+	uint8_t type = arg & 0x0f;
+	uint32_t n = (arg & VEC_256) ? 32 : 16;
+	uint8_t *a, *b;
+	vec_fn_t func;
+
+	if ((opcode < IN_VADD) || (opcode > IN_VHMAX) || (type == 0)
+		|| (type >= VEC_TYPES) || (arg & ~(VEC_256 | 0x0f)))
+		return 1;
+
+	func = vec_tbl[(arg & VEC_256) ? 1 : 0][opcode - IN_VADD][type];
+	if (func == NULL)
+		return 1;
+
+	a = (uint8_t *)ds_pop(&vm_status->ds, n);
+	if (a == NULL)
+		return 1;
+
+	if (opcode >= IN_VSUM) {
+		/* Horizontal: single lane result replaces the vector */
+		func(a, a, NULL, n);
+		vm_status->ds.st_count += vec_lane[type];
+		return 0;
+	}
+
+	b = (uint8_t *)ds_pop(&vm_status->ds, n);
+	if (b == NULL)
+		return 1;
+
+	/* Result is stored in place of second operand */
+	func(b, a, b, n);
+	vm_status->ds.st_count += n;
+	return 0;
+}
+
+/* Pop 32-bit address or count */
+static int red_pop(ds_t *ds, uint32_t *val)
+{
+	void *ptr = ds_pop(ds, sizeof(uint32_t));
+	if (ptr == NULL)
+		return 1;
+	memcpy(val, ptr, sizeof(uint32_t));
+	return 0;
+}
+
+int in_red(vm_t *vm_status, uint8_t opcode, uint8_t arg)
+{
+	uint8_t type = arg & 0x0f;
+	uint8_t *a, *b, *c;
+	uint64_t sz;
+	uint32_t n, addr;
+	float f;
+	double d;
+	uint8_t res[sizeof(double)];
+
+	if (((type != VEC_F32) && (type != VEC_F64))
+		|| (arg & ~(RED_MEM | RED_ORD | 0x0f)))
+		return 1;
+
+	if (opcode == IN_FMA) {
+		if (arg != type)
+			return 1;
+		a = (uint8_t *)ds_pop(&vm_status->ds, vec_lane[type]);
+		b = (uint8_t *)ds_pop(&vm_status->ds, vec_lane[type]);
+		c = (uint8_t *)ds_pop(&vm_status->ds, vec_lane[type]);
+		if ((a == NULL) || (b == NULL) || (c == NULL))
+			return 1;
+		if (type == VEC_F32) {
+			f = fmaf(*(float *)a, *(float *)b, *(float *)c);
+			return ds_pushraw(&vm_status->ds, sizeof(float), &f);
+		}
+		d = fma(*(double *)a, *(double *)b, *(double *)c);
+		return ds_pushraw(&vm_status->ds, sizeof(double), &d);
+	}
+
+	if (red_pop(&vm_status->ds, &n))
+		return 1;
+	sz = (uint64_t)n * vec_lane[type];
+	if (sz > UINT32_MAX)
+		return 1;
+
+	if (arg & RED_MEM) {
+		if (red_pop(&vm_status->ds, &addr))
+			return 1;
+		a = (uint8_t *)lm_getelem(&vm_status->lm, addr, sz);
+		b = a;
+		if (opcode == IN_FDOT) {
+			if (red_pop(&vm_status->ds, &addr))
+				return 1;
+			b = (uint8_t *)lm_getelem(&vm_status->lm, addr, sz);
+		}
+	} else {
+		a = (uint8_t *)ds_pop(&vm_status->ds, sz);
+		b = (opcode == IN_FDOT)
+			? (uint8_t *)ds_pop(&vm_status->ds, sz) : a;
+	}
+	if ((a == NULL) || (b == NULL))
+		return 1;
+
+	((arg & RED_ORD) ? red_seq : red_tbl)[opcode - IN_FDOT]
+		[type - VEC_F32](res, a, b, sz);
+	return ds_pushraw(&vm_status->ds, vec_lane[type], res);
+}
@@ -0,0 +1,122 @@
+/*
+ * vmpool.c - pool of pre-initialized VMs
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* Local includes */
+#include "auvm.h"
+#include "vmpool.h"
+
+/* System includes */
+#include <stdlib.h>
+
+/* Create pool of [n] VMs running objects [argv] */
+vmpool_t *vmpool_create(uint32_t n, uint32_t ds_sz, uint32_t cs_sz,
+		uint32_t lm_sz, int argc, char **argv)
+{
+	vmpool_t *ret;
+
+	if (n == 0)
+		return NULL;
+
+	ret = (vmpool_t *)malloc(sizeof(vmpool_t));
+	if (ret == NULL)
+		return NULL;
+	ret->vms = (vm_t **)malloc(sizeof(vm_t *) * n);
+	ret->free = (uint32_t *)malloc(sizeof(uint32_t) * n);
+	ret->leased = (uint8_t *)calloc(n, 1);
+	if ((ret->vms == NULL) || (ret->free == NULL)
+		|| (ret->leased == NULL)) {
+		free(ret->vms);
+		free(ret->free);
+		free(ret->leased);
+		free(ret);
+		return NULL;
+	}
+
+	ret->size = 0;
+	ret->vms[0] = auvm_init(ds_sz, cs_sz, lm_sz, argc, argv);
+	if (ret->vms[0] == NULL) {
+		vmpool_destroy(ret);
+		return NULL;
+	}
+	for (ret->size = 1; ret->size < n; ret->size++) {
+		ret->vms[ret->size] = auvm_init_shared(ret->vms[0]);
+		if (ret->vms[ret->size] == NULL) {
+			vmpool_destroy(ret);
+			return NULL;
+		}
+	}
+
+	for (ret->avail = 0; ret->avail < n; ret->avail++)
+		ret->free[ret->avail] = ret->avail;
+
+	return ret;
+}
+
+/* Take VM in initial state from pool, NULL if all are leased */
+vm_t *vmpool_lease(vmpool_t *p)
+{
+	uint32_t i;
+
+	if (p->avail == 0)
+		return NULL;
+	i = p->free[--p->avail];
+	p->leased[i] = 1;
+	return p->vms[i];
+}
+
+/* Reset VM and give it back to pool, nonzero if it isn't leased from it */
+int vmpool_release(vmpool_t *p, vm_t *vm_status)
+{
+	uint32_t i;
+
+	for (i = 0; i < p->size; i++)
+		if (p->vms[i] == vm_status)
+			break;
+	if ((i == p->size) || !p->leased[i])
+		return 1;
+	auvm_reset(vm_status);
+	p->leased[i] = 0;
+	p->free[p->avail++] = i;
+	return 0;
+}
+
+void vmpool_destroy(vmpool_t *p)
+{
+	uint32_t i;
+
+	/* Shared VMs first, vms[0] owns their tables */
+	for (i = p->size; i-- > 1; )
+		auvm_destroy_shared(p->vms[i]);
+	if (p->size != 0)
+		auvm_destroy(p->vms[0]);
+	free(p->vms);
+	free(p->free);
+	free(p->leased);
+	free(p);
+}
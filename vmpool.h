@@ -0,0 +1,60 @@
+#ifndef _VMPOOL_H_
+#define _VMPOOL_H_
+
+/*
+ * vmpool.h - pool of pre-initialized VMs
+ *
+ * Copyright (c) 2013 Peter Polacik <polacik.p@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Config file */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* System includes */
+#include <stdint.h>
+
+/* Pool of VMs
+ *
+ * All VMs share instruction, function and object tables of the first one.
+ * Lease is O(1), release finds VM among the pool ones and rejects VMs
+ * which aren't leased. Released VM is reset (not freed). Pool isn't
+ * thread-safe.
+ */
+struct _vm;
+
+struct _vmpool {
+	uint32_t size;
+	uint32_t avail;
+	struct _vm **vms;	/* vms[0] owns shared tables */
+	uint32_t *free;		/* stack of vms[] indexes available for lease */
+	uint8_t *leased;	/* nonzero if vms[i] is leased */
+};
+typedef struct _vmpool vmpool_t;
+
+extern vmpool_t *vmpool_create(uint32_t, uint32_t, uint32_t, uint32_t, int,
+		char **);
+extern struct _vm *vmpool_lease(vmpool_t *);
+extern int vmpool_release(vmpool_t *, struct _vm *);
+extern void vmpool_destroy(vmpool_t *);
+
+#endif /* _VMPOOL_H_ */